@@ -0,0 +1,294 @@
+/*
+ * bench.cxx - Benchmark suite
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../src/geometry.h"
+#include "../src/mesh_io.h"
+#include "../src/path_extrude.h"
+#include "../src/paths.h"
+#include "../examples/examples.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * A benchmark case builds its inputs (path generation), which are then
+ * extruded and exported as binary STL. Each phase is timed separately.
+ */
+struct Bench_case {
+    std::string name;
+    example_callback callback;
+    int poly_size, path_size;
+};
+
+static int stress_poly_size, stress_path_size;
+
+static ExtrudeJob stress() {
+    ExtrudeJob job;
+    double turns = stress_path_size / 100.;
+
+    job.poly = gen_circle_xz(Point(2, 0, 0), 0.5, stress_poly_size);
+    job.path = path_helix(0., turns * 2. * M_PI, 2., turns, Point(0, 0, 0), stress_path_size);
+    job.guide = path_helix(0., turns * 2. * M_PI, 2., turns, Point(0, 0, 1), stress_path_size);
+    job.close_ends = true;
+
+    return job;
+}
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Peak resident set size of the process so far, in kB: each case runs in
+// its own process, so this is the peak of the case
+static long peak_rss() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/*
+ * Number of triangles in a binary STL or PLY file, as declared in its
+ * header: mapped extrusions only know an upper bound up front
+ */
+static size_t written_triangles(const char *fname, const std::string &format) {
+    char header[1024];
+    size_t count = 0;
+    int fd = open(fname, O_RDONLY);
+
+    if(fd < 0)
+        return 0;
+
+    ssize_t len = read(fd, header, sizeof(header) - 1);
+    close(fd);
+    if(len < 0)
+        return 0;
+    header[len] = '\0';
+
+    if(format == "ply") {
+        const char *p = strstr(header, "element face ");
+        if(p != NULL)
+            count = strtoul(p + strlen("element face "), NULL, 10);
+    } else if(len >= 84) {
+        const unsigned char *p = (const unsigned char *)header + 80;
+        count = p[0] | p[1] << 8 | p[2] << 16 | (size_t)p[3] << 24;
+    }
+
+    return count;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-o results.json] [-r repeat] [-j threads] [-m max_vertices] [-s mesh_file] [-F stl|ply|off|obj] [-f] [-c] [-l lod] [-M]\n", prog);
+}
+
+// Export in one of the formats of mesh_io
+template<class T>
+static bool export_mesh(int fd, const std::string &format, const char *name, MeshT<T> &mesh) {
+    if(format == "ply")
+        return write_ply_binary(fd, name, mesh);
+    if(format == "off")
+        return write_off(fd, name, mesh);
+    if(format == "obj")
+        return write_obj(fd, name, mesh);
+    return write_stl_binary(fd, name, mesh);
+}
+
+int main(int argc, char **argv) {
+    const char *out_name = "bench_results.json";
+    const char *stl_name = "/dev/null";
+    int repeat = 3, threads = 1, lod = 0;
+    long max_vertices = 1000000;
+    bool single = false, simplify = false, mapped = false;
+    std::string format("stl");
+    int c;
+
+    while((c = getopt(argc, argv, "o:r:j:m:s:F:fcl:Mh")) != -1) {
+        switch(c) {
+        case 'o': out_name = optarg; break;
+        case 'r': repeat = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        case 'm': max_vertices = atol(optarg); break;
+        case 's': stl_name = optarg; break;
+        case 'F': format = optarg; break;
+        case 'f': single = true; break;
+        case 'c': simplify = true; break;
+        case 'l': lod = atoi(optarg); break;
+        case 'M': mapped = true; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(repeat < 1)
+        repeat = 1;
+    if(format != "stl" && format != "ply" && format != "off" && format != "obj") {
+        usage(argv[0]);
+        return 1;
+    }
+    if(mapped && format != "stl" && format != "ply") {
+        fprintf(stderr, "Only STL and PLY files can be mapped\n");
+        return 1;
+    }
+
+    // Devices and pipes cannot be sized and mapped
+    struct stat st;
+    if(mapped && stat(stl_name, &st) == 0 && !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Mapped output needs a regular file, given with -s\n");
+        return 1;
+    }
+
+    std::vector<Bench_case> cases;
+    std::vector<Example_script> examples = get_examples();
+
+    for(size_t i = 0; i < examples.size(); i++) {
+        Bench_case bc;
+        bc.name = examples[i].name;
+        bc.callback = examples[i].callback;
+        bc.poly_size = bc.path_size = 0;
+        cases.push_back(bc);
+    }
+
+    // Stress cases from 10^2 to 10^6 ring vertices, with small and large polygons
+    int poly_sizes[] = {10, 100, 1000};
+    for(long total = 100; total <= max_vertices; total *= 10) {
+        for(int k = 0; k < 3; k++) {
+            if(total / poly_sizes[k] < 2)
+                continue;
+
+            Bench_case bc;
+            char buf[64];
+            sprintf(buf, "stress_%d_x_%ld", poly_sizes[k], total / poly_sizes[k]);
+            bc.name = buf;
+            bc.callback = stress;
+            bc.poly_size = poly_sizes[k];
+            bc.path_size = total / poly_sizes[k];
+            cases.push_back(bc);
+        }
+    }
+
+    FILE *out = fopen(out_name, "w");
+    if(out == NULL) {
+        fprintf(stderr, "Cannot open %s\n", out_name);
+        return 1;
+    }
+
+    ExtrudeOptions opts;
+    opts.threads = threads;
+    opts.simplify = simplify;
+    opts.lod = lod;
+
+    fprintf(stderr, "%-22s %10s %10s %10s %10s %12s %10s\n", "case", "triangles", "paths(s)", "extrude(s)", "export(s)", "tri/s", "rss(kB)");
+
+    for(size_t i = 0; i < cases.size(); i++) {
+        Bench_case &bc = cases[i];
+        double t_path = 1e300, t_extrude = 1e300, t_export = 1e300;
+        size_t ntri = 0;
+
+        // The parent only waits for the case and stops at the first failure
+        fflush(out);
+        pid_t pid = fork();
+        if(pid < 0) {
+            fprintf(stderr, "Cannot run %s\n", bc.name.c_str());
+            return 1;
+        }
+        if(pid > 0) {
+            int status;
+            if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                return 1;
+            continue;
+        }
+
+        stress_poly_size = bc.poly_size;
+        stress_path_size = bc.path_size;
+
+        // Best of n runs for each phase
+        for(int r = 0; r < repeat; r++) {
+            double t0 = now();
+            ExtrudeJob job = bc.callback();
+            double t1 = now();
+
+            // Mapped output extrudes straight into the file: no export phase
+            if(mapped) {
+                bool ok = format == "ply" ?
+                    path_extrude_ply(stl_name, bc.name.c_str(), job.poly, job.path, job.guide, job.close_ends, opts) :
+                    path_extrude_stl(stl_name, bc.name.c_str(), job.poly, job.path, job.guide, job.close_ends, opts);
+                if(!ok) {
+                    fprintf(stderr, "Cannot write %s\n", stl_name);
+                    return 1;
+                }
+                double t2 = now();
+
+                ntri = written_triangles(stl_name, format);
+                t_path = std::min(t_path, t1 - t0);
+                t_extrude = std::min(t_extrude, t2 - t1);
+                t_export = 0.;
+                continue;
+            }
+
+            Mesh mesh;
+            Meshf meshf;
+            if(single)
+                meshf = path_extrude_meshf(job.poly, job.path, job.guide, job.close_ends, opts);
+            else
+                mesh = path_extrude_mesh(job.poly, job.path, job.guide, job.close_ends, opts);
+            double t2 = now();
+
+            int fd = open(stl_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            bool ok = fd >= 0 && (single ? export_mesh(fd, format, bc.name.c_str(), meshf) : export_mesh(fd, format, bc.name.c_str(), mesh));
+            if(!ok) {
+                fprintf(stderr, "Cannot write %s\n", stl_name);
+                return 1;
+            }
+            close(fd);
+            double t3 = now();
+
+            ntri = single ? meshf.faces.size() : mesh.faces.size();
+            t_path = std::min(t_path, t1 - t0);
+            t_extrude = std::min(t_extrude, t2 - t1);
+            t_export = std::min(t_export, t3 - t2);
+        }
+
+        double rate = t_extrude > 0. ? ntri / t_extrude : 0.;
+        long rss = peak_rss();
+
+        fprintf(stderr, "%-22s %10zu %10.6f %10.6f %10.6f %12.4g %10ld\n", bc.name.c_str(), ntri, t_path, t_extrude, t_export, rate, rss);
+        fprintf(out, "{\"case\": \"%s\", \"poly_size\": %d, \"path_size\": %d, \"threads\": %d, \"repeat\": %d, \"float\": %s, \"simplify\": %s, \"lod\": %d, \"mapped\": %s, \"format\": \"%s\", "
+                     "\"triangles\": %zu, \"path_time\": %g, \"extrude_time\": %g, \"export_time\": %g, "
+                     "\"triangles_per_second\": %g, \"peak_rss_kb\": %ld}\n",
+                bc.name.c_str(), bc.poly_size, bc.path_size, threads, repeat, single ? "true" : "false", simplify ? "true" : "false", lod, mapped ? "true" : "false", format.c_str(),
+                ntri, t_path, t_extrude, t_export, rate, rss);
+
+        fclose(out);
+        return 0;
+    }
+
+    fclose(out);
+    return 0;
+}
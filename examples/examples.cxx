@@ -22,21 +22,28 @@
 
 #include "../src/path_extrude.h"
 #include "../src/paths.h"
+#include "../src/sincos.h"
 #include "examples.h"
 
-Polygon gen_circle_xz(Point center, double radius) {
+Polygon gen_circle_xz(Point center, double radius, int npoints) {
     Polygon poly;
-    double t = 0, dt = 2. * M_PI / 100.;
+    double dt = 2. * M_PI / npoints;
+    std::vector<double> c(npoints), s(npoints);
+    poly.reserve(npoints);
 
-    for(int i = 0; i < 100; i++) {
-        t = i*dt;
-        Vector V(radius * std::cos(t), 0., radius * std::sin(t));
+    sincos_sequence(0., dt, 0, npoints, c.data(), s.data());
+    for(int i = 0; i < npoints; i++) {
+        Vector V(radius * c[i], 0., radius * s[i]);
         poly.push_back(center + V);
     }
 
     return poly;
 }
 
+Polygon gen_circle_xz(Point center, double radius) {
+    return gen_circle_xz(center, radius, 100);
+}
+
 Polygon gen_rectangle_xz(Point center, double width, double height) {
     Polygon poly;
     double a = width / 2.;
@@ -51,46 +58,58 @@ Polygon gen_rectangle_xz(Point center, double width, double height) {
     return poly;
 }
 
-Object pipe() {
-    Polygon poly = gen_circle_xz(Point(0, 0, 0), 1);
+ExtrudeJob pipe() {
+    ExtrudeJob job;
+
+    job.poly = gen_circle_xz(Point(0, 0, 0), 1);
     Path l1 = path_line(Point(0, 0, 0), Point(0, 5, 0), 100);
     Path c1 = path_arc(0., 0.5 * M_PI, 2., Point(-2, 5, 0), 100);
-    Path p1 = path_concat(l1, c1);
+    job.path = path_concat(l1, c1);
 
     Path l2 = path_line(Point(1, 0, 0), Point(1, 5, 0), 100);
     Path c2 = path_arc(0., 0.5 * M_PI, 3., Point(-2, 5, 0), 100);
-    Path p2 = path_concat(l2, c2);
+    job.guide = path_concat(l2, c2);
+    job.close_ends = true;
 
-    return path_extrude(poly, p1, p2, true);
+    return job;
 }
 
-Object ell_torus() {
-    Polygon poly = gen_circle_xz(Point(3, 0, 0), 1);
-    Path e1 = path_ell_arc(0., 1.5 * M_PI, 3., 2., Point(0, 0, 0), 100);
-    Path e2 = path_ell_arc(0., 1.5 * M_PI, 3., 2., Point(0, 0, 1), 100);
+ExtrudeJob ell_torus() {
+    ExtrudeJob job;
+
+    job.poly = gen_circle_xz(Point(3, 0, 0), 1);
+    job.path = path_ell_arc(0., 1.5 * M_PI, 3., 2., Point(0, 0, 0), 100);
+    job.guide = path_ell_arc(0., 1.5 * M_PI, 3., 2., Point(0, 0, 1), 100);
+    job.close_ends = true;
 
-    return path_extrude(poly, e1, e2, true);
+    return job;
 }
 
-Object funnel() {
-    Polygon poly = gen_circle_xz(Point(0, 0, 0), 3);
+ExtrudeJob funnel() {
+    ExtrudeJob job;
 
-    Path l1 = path_line(Point(0, 0, 0), Point(0, 6, 0), 200);
+    job.poly = gen_circle_xz(Point(0, 0, 0), 3);
+
+    job.path = path_line(Point(0, 0, 0), Point(0, 6, 0), 200);
 
     Path l2 = path_line(Point(3, 0, 0), Point(0.5, 3, 0), 100);
     Path l3 = path_line(Point(0.5, 3, 0), Point(0.25, 6, 0), 100);
-    Path p2 = path_concat(l2, l3);
+    job.guide = path_concat(l2, l3);
+    job.close_ends = true;
 
-    return path_extrude(poly, l1, p2, true);
+    return job;
 }
 
-Object spring() {
-    Polygon poly = gen_rectangle_xz(Point(2, 0, 0), 0.5, 0.25);
+ExtrudeJob spring() {
+    ExtrudeJob job;
+
+    job.poly = gen_rectangle_xz(Point(2, 0, 0), 0.5, 0.25);
 
-    Path h1 = path_helix(0., 10. * 2. * M_PI, 2., 10., Point(0, 0, 0), 1000);
-    Path h2 = path_helix(0., 10. * 2. * M_PI, 2., 10., Point(0, 0, 1), 1000);
+    job.path = path_helix(0., 10. * 2. * M_PI, 2., 10., Point(0, 0, 0), 1000);
+    job.guide = path_helix(0., 10. * 2. * M_PI, 2., 10., Point(0, 0, 1), 1000);
+    job.close_ends = true;
 
-    return path_extrude(poly, h1, h2, true);
+    return job;
 }
 
 std::vector<Example_script> get_examples() {
@@ -24,14 +24,19 @@
 #include <vector>
 
 #include "../src/geometry.h"
+#include "../src/path_extrude.h"
 
-typedef Object (*example_callback)();
+typedef ExtrudeJob (*example_callback)();
 struct Example_script {
     const char *name;
     const char *description;
     example_callback callback;
 };
 
+Polygon gen_circle_xz(Point center, double radius);
+Polygon gen_circle_xz(Point center, double radius, int npoints);
+Polygon gen_rectangle_xz(Point center, double width, double height);
+
 std::vector<Example_script> get_examples();
 
 #endif
@@ -19,14 +19,69 @@
  */
 
 #include "../src/geometry.h"
+#include "../src/mesh_io.h"
+#include "../src/path_extrude.h"
 #include "examples.h"
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <vector>
 
-int main(int argc, char **argv) {
-    std::vector<Example_script> examples = get_examples();
+#include <unistd.h>
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-e example|number|all]... [-r repeat] [-j threads] [-F ascii|stl|ply|off|obj] [-o file] [-c] [-l]\n"
+                    "Without -e, the example is asked for on the standard input.\n"
+                    "With -c, every mesh is checked to be closed.\n", prog);
+}
+
+// Whole decimal integer, else false
+static bool parse_int(const char *arg, int &value) {
+    char *end;
+    long v = strtol(arg, &end, 10);
+
+    if(*arg == '\0' || *end != '\0' || v < INT_MIN || v > INT_MAX)
+        return false;
+
+    value = v;
+    return true;
+}
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Pick the examples matching a name, a 1-based number or "all"
+static bool select_examples(const std::vector<Example_script> &examples, const char *arg, std::vector<size_t> &selected) {
+    if(strcmp(arg, "all") == 0) {
+        for(size_t i = 0; i < examples.size(); i++)
+            selected.push_back(i);
+        return true;
+    }
+
+    for(size_t i = 0; i < examples.size(); i++) {
+        if(strcmp(arg, examples[i].name) == 0) {
+            selected.push_back(i);
+            return true;
+        }
+    }
+
+    char *end;
+    long k = strtol(arg, &end, 10);
+    if(*end != '\0' || k < 1 || k > (long)examples.size())
+        return false;
+
+    selected.push_back(k - 1);
+    return true;
+}
+
+static size_t ask_example(const std::vector<Example_script> &examples) {
     size_t i;
 
     std::cout << "Path extrusion examples" << std::endl;
@@ -43,32 +98,183 @@ int main(int argc, char **argv) {
             break;
     }
 
-    Example_script script = examples[i-1];
+    return i - 1;
+}
+
+static bool write_ascii_stl(const char *fname, const char *name, const Mesh &mesh) {
+    FILE *fd = fopen(fname, "w");
+
+    if(fd == NULL)
+        return false;
+
+    fprintf(fd, "solid %s\n", name);
+    for(size_t i = 0; i < mesh.faces.size(); i++)
+        mesh.triangle(i).WriteSTL(fd);
+    fprintf(fd, "endsolid\n");
+
+    return fclose(fd) == 0;
+}
+
+/*
+ * Number of edges not shared by exactly two faces, using it in opposite
+ * directions: a closed, consistently oriented mesh has none
+ */
+static size_t open_edges(const Mesh &mesh) {
+    std::vector<std::pair<unsigned int, unsigned int> > edges, reversed;
+
+    for(size_t f = 0; f < mesh.faces.size(); f++) {
+        const unsigned int *v = mesh.faces[f].indices;
+        for(int k = 0; k < 3; k++) {
+            edges.push_back(std::make_pair(v[k], v[(k + 1) % 3]));
+            reversed.push_back(std::make_pair(v[(k + 1) % 3], v[k]));
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+    std::sort(reversed.begin(), reversed.end());
+
+    size_t open = 0;
+    for(size_t i = 0; i < edges.size(); i++) {
+        bool repeated = (i > 0 && edges[i] == edges[i - 1]) || (i + 1 < edges.size() && edges[i] == edges[i + 1]);
+        if(repeated || !std::binary_search(reversed.begin(), reversed.end(), edges[i]))
+            open++;
+    }
 
-    std::string sline("solid "), fname(script.name);
-    fname += ".stl";
-    sline += script.name;
-    sline += "\n";
+    return open;
+}
 
-    FILE *fd = fopen(fname.c_str(), "w");
+static bool export_mesh(const std::string &format, const char *fname, const char *name, const Mesh &mesh) {
+    if(format == "stl")
+        return write_stl_binary(fname, name, mesh);
+    if(format == "ply")
+        return write_ply_binary(fname, name, mesh);
+    if(format == "off")
+        return write_off(fname, name, mesh);
+    if(format == "obj")
+        return write_obj(fname, name, mesh);
+    return write_ascii_stl(fname, name, mesh);
+}
 
-    if(fd == NULL) {
-        std::cout << "Cannot open " << fname << std::endl;
+/*
+ * Run each selected example repeat times, writing the mesh every time, and
+ * report the best and total times. Output goes to <name>.<format> unless a
+ * file is given, which can only hold one example unless it is /dev/null.
+ * With -c, an example whose mesh is not closed fails before being written.
+ */
+int main(int argc, char **argv) {
+    std::vector<Example_script> examples = get_examples();
+    std::vector<size_t> selected;
+    const char *out_name = NULL;
+    std::string format("ascii");
+    int repeat = 1, threads = 1;
+    bool check = false;
+    int c;
+
+    while((c = getopt(argc, argv, "e:r:j:F:o:clh")) != -1) {
+        switch(c) {
+        case 'e':
+            if(!select_examples(examples, optarg, selected)) {
+                fprintf(stderr, "Unknown example %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r':
+            if(!parse_int(optarg, repeat) || repeat < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'j':
+            if(!parse_int(optarg, threads) || threads < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'F': format = optarg; break;
+        case 'o': out_name = optarg; break;
+        case 'c': check = true; break;
+        case 'l':
+            for(size_t i = 0; i < examples.size(); i++)
+                printf("%zu\t%s\t%s\n", i + 1, examples[i].name, examples[i].description);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(optind < argc
+       || (format != "ascii" && format != "stl" && format != "ply" && format != "off" && format != "obj")) {
+        usage(argv[0]);
         return 1;
     }
 
-    fprintf(fd, sline.c_str());
+    if(out_name != NULL && selected.size() > 1 && strcmp(out_name, "/dev/null") != 0) {
+        fprintf(stderr, "Each example would overwrite %s: give one example, or no file\n", out_name);
+        return 1;
+    }
 
-    Object obj = script.callback();
+    bool interactive = selected.empty();
+    if(interactive)
+        selected.push_back(ask_example(examples));
 
-    for(Object::iterator it = obj.begin(); it != obj.end(); it++)
-        (*it).WriteSTL(fd);
+    ExtrudeOptions opts;
+    opts.threads = threads;
 
-    fprintf(fd, "endsolid\n");
-    fclose(fd);
+    size_t total_triangles = 0;
+    double total_extrude = 0., total_export = 0.;
+
+    for(size_t s = 0; s < selected.size(); s++) {
+        const Example_script &script = examples[selected[s]];
+        std::string fname(script.name);
+        fname += format == "ascii" ? ".stl" : "." + format;
+        if(out_name != NULL)
+            fname = out_name;
+
+        ExtrudeJob job = script.callback();
+        double best_extrude = 0., best_export = 0.;
+        size_t ntri = 0;
+
+        for(int r = 0; r < repeat; r++) {
+            double t0 = now();
+            Mesh mesh = path_extrude_mesh(job.poly, job.path, job.guide, job.close_ends, opts);
+            double t1 = now();
+
+            // Checked outside the timed regions
+            size_t open = check ? open_edges(mesh) : 0;
+            if(open > 0) {
+                fprintf(stderr, "%s: %zu edges are not shared by exactly two faces\n", script.name, open);
+                return 1;
+            }
 
-    std::cout << "Result wrote to " << fname << std::endl;
+            double t2 = now();
+            if(!export_mesh(format, fname.c_str(), script.name, mesh)) {
+                fprintf(stderr, "Cannot write %s\n", fname.c_str());
+                return 1;
+            }
+            double t3 = now();
+
+            ntri = mesh.faces.size();
+            best_extrude = r == 0 ? t1 - t0 : std::min(best_extrude, t1 - t0);
+            best_export = r == 0 ? t3 - t2 : std::min(best_export, t3 - t2);
+            total_extrude += t1 - t0;
+            total_export += t3 - t2;
+            total_triangles += ntri;
+        }
+
+        if(interactive) {
+            std::cout << "Result wrote to " << fname << std::endl;
+            continue;
+        }
+
+        printf("%-12s %10zu triangles  extrude %10.6f s  export %10.6f s  %12.4g triangles/s  -> %s\n",
+               script.name, ntri, best_extrude, best_export, best_extrude > 0. ? ntri / best_extrude : 0., fname.c_str());
+    }
+
+    if(!interactive) {
+        double total = total_extrude + total_export;
+        printf("total        %10zu triangles  extrude %10.6f s  export %10.6f s  %12.4g triangles/s overall (%d runs, %d threads)\n",
+               total_triangles, total_extrude, total_export, total > 0. ? total_triangles / total : 0., repeat * (int)selected.size(), threads);
+    }
 
     return 0;
 }
-
@@ -0,0 +1,79 @@
+/*
+ * arena.cxx - Monotonic memory arena
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+Arena::Arena(size_t block_size): block_size(block_size), used(0), nblocks(0), total(0) {
+}
+
+Arena::~Arena() {
+    for(size_t i = 0; i < this->pool.size(); i++)
+        std::free(this->pool[i].data);
+}
+
+void *Arena::allocate(size_t bytes, size_t align) {
+    if(!this->pool.empty()) {
+        Block &b = this->pool.back();
+        size_t offset = (this->used + align - 1) & ~(align - 1);
+        if(offset + bytes <= b.size) {
+            this->used = offset + bytes;
+            return b.data + offset;
+        }
+    }
+
+    // Blocks come from malloc, which is suitably aligned for any type. They
+    // grow with the arena so that the number of blocks stays logarithmic.
+    Block b;
+    b.size = std::max(std::max(this->block_size, this->total), bytes);
+    b.data = static_cast<char *>(std::malloc(b.size));
+    if(b.data == NULL)
+        throw std::bad_alloc();
+
+    this->pool.push_back(b);
+    this->used = bytes;
+    this->nblocks++;
+    this->total += b.size;
+
+    return b.data;
+}
+
+void Arena::reset() {
+    if(this->pool.empty())
+        return;
+
+    size_t largest = 0;
+    for(size_t i = 1; i < this->pool.size(); i++)
+        if(this->pool[i].size > this->pool[largest].size)
+            largest = i;
+
+    for(size_t i = 0; i < this->pool.size(); i++)
+        if(i != largest)
+            std::free(this->pool[i].data);
+
+    Block keep = this->pool[largest];
+    this->pool.clear();
+    this->pool.push_back(keep);
+    this->used = 0;
+    this->total = keep.size;
+}
@@ -0,0 +1,68 @@
+/*
+ * arena.h - Monotonic memory arena
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_ARENA_H_
+#define _I_ARENA_H_
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * Monotonic allocator: memory is carved out of large blocks and only given
+ * back all at once, by reset() or on destruction. Objects allocated from an
+ * arena are never destroyed, so it only holds trivially destructible types.
+ * An arena is not thread-safe; workers get their buffers carved out before
+ * they are started.
+ */
+class Arena {
+public:
+    Arena(size_t block_size = 1 << 16);
+    ~Arena();
+
+    void *allocate(size_t bytes, size_t align);
+
+    template<class T>
+    T *alloc(size_t n) {
+        return static_cast<T *>(this->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // Release everything, keeping the largest block for the next use
+    void reset();
+
+    // Number of blocks obtained from the system, and their total size
+    size_t blocks() const { return this->nblocks; }
+    size_t capacity() const { return this->total; }
+
+private:
+    struct Block {
+        char *data;
+        size_t size;
+    };
+
+    std::vector<Block> pool;
+    size_t block_size;
+    size_t used;            // bytes used in the last block of the pool
+    size_t nblocks, total;
+
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+};
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ * extrude_cache.cxx - Content-addressed cache of extrusions
+ * 
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "extrude_cache.h"
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3 0x165667B19E3779F9ULL
+
+// Raw mesh files: magic, vertex and face counts, then the arrays as in memory
+#define MESH_MAGIC "PXMESH01"
+#define MESH_HEADER_SIZE 24
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Final avalanche of MurmurHash3
+static inline uint64_t fmix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/*
+ * Two independent lanes fed with the same 64-bit words, in the manner of
+ * the xxHash rounds: about one multiply per word and lane
+ */
+class Hasher {
+public:
+    uint64_t a, b;
+
+    Hasher(): a(HASH_PRIME1), b(HASH_PRIME2) {}
+
+    void word(uint64_t w) {
+        this->a = rotl(this->a ^ (w * HASH_PRIME2), 31) * HASH_PRIME1;
+        this->b = rotl(this->b + w * HASH_PRIME3, 27) * HASH_PRIME2;
+    }
+
+    void bytes(const void *data, size_t len) {
+        const char *p = static_cast<const char *>(data);
+        uint64_t w;
+
+        this->word(len);
+        for(; len >= 8; len -= 8, p += 8) {
+            std::memcpy(&w, p, 8);
+            this->word(w);
+        }
+        if(len > 0) {
+            w = 0;
+            std::memcpy(&w, p, len);
+            this->word(w);
+        }
+    }
+
+    void real(double x) {
+        uint64_t w;
+        std::memcpy(&w, &x, 8);
+        this->word(w);
+    }
+};
+
+ExtrudeKey::ExtrudeKey(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts) {
+    Hasher H;
+
+    H.bytes(poly.data(), poly.size() * sizeof(Point));
+    H.bytes(path.data(), path.size() * sizeof(PathSample));
+    H.bytes(guide.data(), guide.size() * sizeof(PathSample));
+    H.word(close_ends);
+    H.real(opts.twist);
+    H.word(opts.simplify);
+    H.word(opts.lod);
+
+    this->h[0] = fmix(H.a ^ rotl(H.b, 32));
+    this->h[1] = fmix(H.b + H.a);
+}
+
+std::string ExtrudeKey::hex() const {
+    char buf[33];
+    std::snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)this->h[0], (unsigned long long)this->h[1]);
+    return buf;
+}
+
+static size_t mesh_bytes(const Mesh &mesh) {
+    return mesh.vertices.size() * sizeof(Point) + mesh.faces.size() * sizeof(Face);
+}
+
+// The directory is created if needed, its parent must exist
+ExtrudeCache::ExtrudeCache(size_t max_bytes, const char *dir) {
+    this->max_bytes = max_bytes;
+    this->used = 0;
+    if(dir != NULL) {
+        this->dir = dir;
+        mkdir(dir, 0755);
+    }
+    this->nhits = this->ndisk_hits = this->nmisses = this->nstore_failures = 0;
+}
+
+std::shared_ptr<const Mesh> ExtrudeCache::extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts) {
+    ExtrudeKey K(poly, path, guide, close_ends, opts);
+    std::shared_ptr<const Mesh> found = this->lookup(K);
+
+    if(found)
+        return found;
+
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    bool on_disk = !this->dir.empty() && this->load(K, *mesh);
+
+    bool stored = true;
+    if(!on_disk) {
+        *mesh = path_extrude_mesh(poly, path, guide, close_ends, opts);
+        if(!this->dir.empty())
+            stored = this->store(K, *mesh);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if(on_disk)
+            this->ndisk_hits++;
+        else
+            this->nmisses++;
+        if(!stored)
+            this->nstore_failures++;
+    }
+
+    this->insert(K, mesh);
+    return mesh;
+}
+
+std::shared_ptr<const Mesh> ExtrudeCache::lookup(const ExtrudeKey &K) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    auto it = this->index.find(K);
+
+    if(it == this->index.end())
+        return std::shared_ptr<const Mesh>();
+
+    this->lru.splice(this->lru.begin(), this->lru, it->second);
+    this->nhits++;
+    return it->second->second;
+}
+
+/*
+ * Keep the mesh unless it alone exceeds the limit, then drop the least
+ * recently used ones until under it again
+ */
+void ExtrudeCache::insert(const ExtrudeKey &K, const std::shared_ptr<const Mesh> &mesh) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    size_t size = mesh_bytes(*mesh);
+
+    if(size > this->max_bytes || this->index.count(K) > 0)
+        return;
+
+    this->lru.push_front(Entry(K, mesh));
+    this->index[K] = this->lru.begin();
+    this->used += size;
+
+    while(this->used > this->max_bytes) {
+        Entry &last = this->lru.back();
+        this->used -= mesh_bytes(*last.second);
+        this->index.erase(last.first);
+        this->lru.pop_back();
+    }
+}
+
+size_t ExtrudeCache::hits() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->nhits;
+}
+
+size_t ExtrudeCache::disk_hits() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->ndisk_hits;
+}
+
+size_t ExtrudeCache::misses() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->nmisses;
+}
+
+size_t ExtrudeCache::store_failures() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->nstore_failures;
+}
+
+size_t ExtrudeCache::bytes() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->used;
+}
+
+void ExtrudeCache::clear() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->lru.clear();
+    this->index.clear();
+    this->used = 0;
+}
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = static_cast<const char *>(data);
+
+    while(len > 0) {
+        ssize_t r = ::write(fd, p, len);
+        if(r < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        p += r;
+        len -= r;
+    }
+
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t len) {
+    char *p = static_cast<char *>(data);
+
+    while(len > 0) {
+        ssize_t r = ::read(fd, p, len);
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r <= 0)
+            return false;
+        p += r;
+        len -= r;
+    }
+
+    return true;
+}
+
+/*
+ * The files are written in native byte order, for the machine that made
+ * them; a file of the wrong size, or with faces referring to missing
+ * vertices, is ignored
+ */
+bool ExtrudeCache::load(const ExtrudeKey &K, Mesh &mesh) const {
+    std::string fname = this->dir + "/" + K.hex() + ".mesh";
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    char header[MESH_HEADER_SIZE];
+    uint64_t nv, nf;
+    struct stat st;
+
+    if(fd < 0)
+        return false;
+
+    bool ok = fstat(fd, &st) == 0 && read_all(fd, header, MESH_HEADER_SIZE)
+           && std::memcmp(header, MESH_MAGIC, 8) == 0;
+    if(ok) {
+        std::memcpy(&nv, header + 8, 8);
+        std::memcpy(&nf, header + 16, 8);
+        // Bounded by the file size first, so that the sum cannot overflow
+        uint64_t size = st.st_size;
+        ok = nv <= size / sizeof(Point) && nf <= size / sizeof(Face)
+          && size == MESH_HEADER_SIZE + nv * sizeof(Point) + nf * sizeof(Face);
+    }
+    if(ok) {
+        mesh.vertices.resize(nv);
+        mesh.faces.resize(nf);
+        ok = read_all(fd, mesh.vertices.data(), nv * sizeof(Point))
+          && read_all(fd, mesh.faces.data(), nf * sizeof(Face));
+    }
+    for(uint64_t f = 0; ok && f < nf; f++) {
+        const unsigned int *v = mesh.faces[f].indices;
+        ok = v[0] < nv && v[1] < nv && v[2] < nv;
+    }
+
+    close(fd);
+    return ok;
+}
+
+// Written aside and renamed into place, so that readers never see part of a file
+bool ExtrudeCache::store(const ExtrudeKey &K, const Mesh &mesh) const {
+    std::string fname = this->dir + "/" + K.hex() + ".mesh";
+    std::string tmp = fname + ".XXXXXX";
+    char header[MESH_HEADER_SIZE];
+    uint64_t nv = mesh.vertices.size(), nf = mesh.faces.size();
+
+    static_assert(sizeof(Point) == 3 * sizeof(double), "Point must be three packed doubles");
+    static_assert(sizeof(Face) == 3 * sizeof(unsigned int), "Face must be three packed indices");
+
+    int fd = mkstemp(&tmp[0]);
+    if(fd < 0)
+        return false;
+    fchmod(fd, 0644);
+
+    std::memcpy(header, MESH_MAGIC, 8);
+    std::memcpy(header + 8, &nv, 8);
+    std::memcpy(header + 16, &nf, 8);
+
+    bool ok = write_all(fd, header, MESH_HEADER_SIZE)
+           && write_all(fd, mesh.vertices.data(), nv * sizeof(Point))
+           && write_all(fd, mesh.faces.data(), nf * sizeof(Face));
+    if(close(fd) < 0)
+        ok = false;
+
+    if(ok && rename(tmp.c_str(), fname.c_str()) == 0)
+        return true;
+
+    unlink(tmp.c_str());
+    return false;
+}
@@ -0,0 +1,102 @@
+/*
+ * extrude_cache.h - Content-addressed cache of extrusions
+ * 
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_EXTRUDE_CACHE_H_
+#define _I_EXTRUDE_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "geometry.h"
+#include "path_extrude.h"
+
+/*
+ * 128-bit digest of the inputs of an extrusion: the polygon, path and
+ * guide samples, close_ends and the options the mesh depends on
+ */
+class ExtrudeKey {
+public:
+    uint64_t h[2];
+
+    ExtrudeKey(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts);
+
+    bool operator ==(const ExtrudeKey &K) const { return this->h[0] == K.h[0] && this->h[1] == K.h[1]; }
+
+    // 32 hexadecimal digits
+    std::string hex() const;
+};
+
+/*
+ * Meshes of past extrusions, looked up by the digest of their inputs. The
+ * most recently used ones are kept in memory up to max_bytes of vertices
+ * and faces; with a directory, created if missing, every mesh computed is
+ * also stored there in a raw binary form, and found again by later runs.
+ * Lookups are thread-safe, and extrusions run outside the lock.
+ */
+class ExtrudeCache {
+public:
+    ExtrudeCache(size_t max_bytes, const char *dir = NULL);
+
+    std::shared_ptr<const Mesh> extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts);
+
+    // Found in memory, found on disk, computed
+    size_t hits() const;
+    size_t disk_hits() const;
+    size_t misses() const;
+
+    // Meshes computed which could not be written to the directory
+    size_t store_failures() const;
+
+    // Memory used by the meshes kept
+    size_t bytes() const;
+
+    void clear();
+
+private:
+    class KeyHash {
+    public:
+        size_t operator ()(const ExtrudeKey &K) const { return K.h[0]; }
+    };
+
+    typedef std::pair<ExtrudeKey, std::shared_ptr<const Mesh> > Entry;
+
+    size_t max_bytes, used;
+    std::string dir;
+    size_t nhits, ndisk_hits, nmisses, nstore_failures;
+    std::list<Entry> lru;   // most recently used first
+    std::unordered_map<ExtrudeKey, std::list<Entry>::iterator, KeyHash> index;
+    mutable std::mutex lock;
+
+    std::shared_ptr<const Mesh> lookup(const ExtrudeKey &K);
+    void insert(const ExtrudeKey &K, const std::shared_ptr<const Mesh> &mesh);
+
+    bool load(const ExtrudeKey &K, Mesh &mesh) const;
+    bool store(const ExtrudeKey &K, const Mesh &mesh) const;
+
+    ExtrudeCache(const ExtrudeCache &);
+    ExtrudeCache &operator =(const ExtrudeCache &);
+};
+
+#endif
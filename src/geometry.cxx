@@ -20,92 +20,45 @@
 
 #include <cmath>
 #include <cstdio>
+#include <type_traits>
 
 #include "geometry.h"
 
-Vector::Vector() {
-    this->x = 0.0;
-    this->y = 0.0;
-    this->z = 0.0;
-}
-
-Vector::Vector(double x, double y, double z) {
-    this->x = x;
-    this->y = y;
-    this->z = z;
-}
-
-Vector::Vector(const Vector &V) {
-    this->x = V.x;
-    this->y = V.y;
-    this->z = V.z;
-}
+static_assert(std::is_trivially_copyable<Vector>::value, "Vector must be trivially copyable");
+static_assert(std::is_trivially_copyable<Point>::value, "Point must be trivially copyable");
+static_assert(std::is_trivially_copyable<Triangle>::value, "Triangle must be trivially copyable");
 
-Vector Vector::operator +() {
-    return Vector(*this);
-}
-
-Vector Vector::operator -() {
-    return Vector(-this->x, -this->y, -this->z);
-}
-
-Vector Vector::operator +(const Vector V) {
-    return Vector(this->x + V.x, this->y + V.y, this->z + V.z);
-}
-
-Vector Vector::operator -(const Vector V) {
-    return Vector(this->x - V.x, this->y - V.y, this->z - V.z);
-}
-
-Vector operator *(double k, Vector V) {
-    return Vector(k * V.x, k * V.y, k * V.z);
-}
-
-Vector Vector::operator +=(const Vector V) {
+template<class T>
+VectorT<T> &VectorT<T>::operator +=(const VectorT &V) {
     this->x += V.x;
     this->y += V.y;
     this->z += V.z;
     return *this;
 }
 
-Vector Vector::operator -=(const Vector V) {
+template<class T>
+VectorT<T> &VectorT<T>::operator -=(const VectorT &V) {
     this->x -= V.x;
     this->y -= V.y;
     this->z -= V.z;
     return *this;
 }
 
-Vector Vector::operator *=(double k) {
+template<class T>
+VectorT<T> &VectorT<T>::operator *=(T k) {
     this->x *= k;
     this->y *= k;
     this->z *= k;
     return *this;
 }
 
-Vector Vector::operator =(const Vector V) {
-    this->x = V.x;
-    this->y = V.y;
-    this->z = V.z;
-    return *this;
-}
-
-double Vector::dot(Vector X, Vector Y) {
-    return X.x * Y.x + X.y * Y.y + X.z * Y.z;
-}
-
-Vector Vector::cross(Vector X, Vector Y) {
-    Vector V;
-    V.x = X.y * Y.z - X.z * Y.y;
-    V.y = X.z * Y.x - X.x * Y.z;
-    V.z = X.x * Y.y - X.y * Y.x;
-    return V;
-}
-
-double Vector::norm() {
-    return std::sqrt(Vector::dot(*this, *this));
+template<class T>
+T VectorT<T>::norm() const {
+    return std::sqrt(VectorT::dot(*this, *this));
 }
 
-std::string Vector::dump() {
+template<class T>
+std::string VectorT<T>::dump() const {
     char buf[16];
     std::string s;
 
@@ -121,36 +74,18 @@ std::string Vector::dump() {
     return s;
 }
 
-Triangle::Triangle() {
-}
-
-Triangle::Triangle(Point A, Point B, Point C) {
-    this->points[0] = A;
-    this->points[1] = B;
-    this->points[2] = C;
-}
-
-Triangle::Triangle(const Triangle &T) {
-    for(size_t i = 0; i < 3; i++)
-        this->points[i] = T.points[i];
-}
-
-Triangle Triangle::operator=(const Triangle &T) {
-    for(size_t i = 0; i < 3; i++)
-        this->points[i] = T.points[i];
-    return *this;
-}
-
-Vector Triangle::normal() {
-    Vector v1(this->points[1] - this->points[0]);
-    Vector v2(this->points[2] - this->points[0]);
-    Vector V = Vector::cross(v1, v2);
-    double n = 1. / V.norm();
+template<class T>
+VectorT<T> TriangleT<T>::normal() const {
+    VectorT<T> v1(this->points[1] - this->points[0]);
+    VectorT<T> v2(this->points[2] - this->points[0]);
+    VectorT<T> V = VectorT<T>::cross(v1, v2);
+    T n = 1. / V.norm();
     return n * V;
 }
 
-void Triangle::WriteSTL(FILE *fd) {
-    Vector N = this->normal();
+template<class T>
+void TriangleT<T>::WriteSTL(FILE *fd) const {
+    VectorT<T> N = this->normal();
     fprintf(fd, "  facet normal %e %e %e\n", N.x, N.y, N.z);
     fprintf(fd, "    outer loop\n");
 
@@ -161,3 +96,27 @@ void Triangle::WriteSTL(FILE *fd) {
     fprintf(fd, "  endfacet\n");
 }
 
+
+template<class T>
+TriangleT<T> MeshT<T>::triangle(size_t i) const {
+    const Face &F = this->faces[i];
+    return TriangleT<T>(this->vertices[F.indices[0]], this->vertices[F.indices[1]], this->vertices[F.indices[2]]);
+}
+
+template<class T>
+std::vector<TriangleT<T> > MeshT<T>::ToObject() const {
+    std::vector<TriangleT<T> > obj;
+
+    obj.reserve(this->faces.size());
+    for(size_t i = 0; i < this->faces.size(); i++)
+        obj.push_back(this->triangle(i));
+
+    return obj;
+}
+
+template class VectorT<double>;
+template class VectorT<float>;
+template class TriangleT<double>;
+template class TriangleT<float>;
+template class MeshT<double>;
+template class MeshT<float>;
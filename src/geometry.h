@@ -22,68 +22,137 @@
 #define _I_GEOMETRY_H_
 
 #include <cstdio>
-#include <list>
 #include <string>
 #include <utility>
+#include <vector>
 
-class Vector {
+/*
+ * The geometry core is templated on the scalar type. Only double (the
+ * default, used for paths and frames) and float (for compact output) are
+ * instantiated, in geometry.cxx and matrix.cxx.
+ */
+template<class T = double>
+class VectorT {
 public:
-    double x, y, z;
+    T x, y, z;
+
+    constexpr VectorT(): x(0), y(0), z(0) {}
+    constexpr VectorT(T x, T y, T z): x(x), y(y), z(z) {}
 
-    Vector();
-    Vector(double x, double y, double z);
-    Vector(const Vector &V);
+    // Conversion between precisions must be asked for
+    template<class U>
+    constexpr explicit VectorT(const VectorT<U> &V): x(V.x), y(V.y), z(V.z) {}
 
-    Vector operator +();
-    Vector operator -();
+    constexpr VectorT operator +() const {
+        return *this;
+    }
 
-    Vector operator +(const Vector V);
-    Vector operator -(const Vector V);
+    constexpr VectorT operator -() const {
+        return VectorT(-this->x, -this->y, -this->z);
+    }
 
-    Vector operator +=(const Vector V);
-    Vector operator -=(const Vector V);
-    Vector operator *=(double k);
+    constexpr VectorT operator +(const VectorT &V) const {
+        return VectorT(this->x + V.x, this->y + V.y, this->z + V.z);
+    }
 
-    Vector operator =(const Vector V);
+    constexpr VectorT operator -(const VectorT &V) const {
+        return VectorT(this->x - V.x, this->y - V.y, this->z - V.z);
+    }
 
-    static double dot(Vector X, Vector Y);
-    static Vector cross(Vector X, Vector Y);
+    VectorT &operator +=(const VectorT &V);
+    VectorT &operator -=(const VectorT &V);
+    VectorT &operator *=(T k);
 
-    double norm();
+    static constexpr T dot(const VectorT &X, const VectorT &Y) {
+        return X.x * Y.x + X.y * Y.y + X.z * Y.z;
+    }
 
-    std::string dump();
+    static constexpr VectorT cross(const VectorT &X, const VectorT &Y) {
+        return VectorT(X.y * Y.z - X.z * Y.y, X.z * Y.x - X.x * Y.z, X.x * Y.y - X.y * Y.x);
+    }
+
+    T norm() const;
+
+    std::string dump() const;
 };
 
-Vector operator *(double k, Vector V);
+typedef VectorT<double> Vector;
+typedef VectorT<float> Vectorf;
+
+constexpr Vector operator *(double k, const Vector &V) {
+    return Vector(k * V.x, k * V.y, k * V.z);
+}
 
-class Point: public Vector {
+constexpr Vectorf operator *(float k, const Vectorf &V) {
+    return Vectorf(k * V.x, k * V.y, k * V.z);
+}
+
+template<class T = double>
+class PointT: public VectorT<T> {
 public:
     
-    Point(): Vector() {}
-    Point(double x, double y, double z): Vector(x, y, z) {}
-    Point(const Vector &V): Vector(V) {}
-    Point(const Point &P): Vector((const Vector&)P) {}
+    constexpr PointT(): VectorT<T>() {}
+    constexpr PointT(T x, T y, T z): VectorT<T>(x, y, z) {}
+    constexpr PointT(const VectorT<T> &V): VectorT<T>(V) {}
+
+    template<class U>
+    constexpr explicit PointT(const PointT<U> &P): VectorT<T>(P.x, P.y, P.z) {}
 };
 
-class Triangle {
+typedef PointT<double> Point;
+typedef PointT<float> Pointf;
+
+template<class T = double>
+class TriangleT {
 public:
-    Point points[3];
+    PointT<T> points[3];
+
+    constexpr TriangleT() {}
+    constexpr TriangleT(const PointT<T> &A, const PointT<T> &B, const PointT<T> &C): points{A, B, C} {}
+
+    VectorT<T> normal() const;
+    void WriteSTL(FILE *s) const;
+};
 
-    Triangle();
-    Triangle(Point A, Point B, Point C);
-    Triangle(const Triangle &T);
+typedef TriangleT<double> Triangle;
+typedef TriangleT<float> Trianglef;
 
-    Triangle operator =(const Triangle &T);
+typedef std::vector<Point> Polygon;
 
-    Vector normal();
-    void WriteSTL(FILE *s);
+typedef std::vector<Triangle> Object;
+typedef std::vector<Trianglef> Objectf;
+
+/*
+ * Consumer for triangles produced incrementally
+ */
+class TriangleSink {
+public:
+    virtual ~TriangleSink() {}
+    virtual void put(const Triangle *triangles, size_t n) = 0;
 };
 
-typedef std::list<Point> Polygon;
+class Face {
+public:
+    unsigned int indices[3];
+
+    constexpr Face(): indices{0, 0, 0} {}
+    constexpr Face(unsigned int a, unsigned int b, unsigned int c): indices{a, b, c} {}
+};
+
+template<class T = double>
+class MeshT {
+public:
+    std::vector<PointT<T> > vertices;
+    std::vector<Face> faces;
+
+    TriangleT<T> triangle(size_t i) const;
+    std::vector<TriangleT<T> > ToObject() const;
+};
 
-typedef std::list<Triangle> Object;
+typedef MeshT<double> Mesh;
+typedef MeshT<float> Meshf;
 
-typedef std::list<std::pair<Point, Vector> > Path;
+typedef std::vector<std::pair<Point, Vector> > Path;
 
 #endif
 
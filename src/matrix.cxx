@@ -20,55 +20,47 @@
 
 #include <cmath>
 #include <cstdio>
+#include <type_traits>
 
 #include "matrix.h"
 
-Matrix::Matrix() {
-    for(int i = 0; i < 3; i++)
-        for(int j = 0; j < 3; j++)
-            this->coeffs[i][j] = 0.;
-}
-
-Matrix::Matrix(const Vector c1, const Vector c2, const Vector c3) {
-    this->AssignColumns(c1, c2, c3);
-}
+static_assert(std::is_trivially_copyable<Matrix>::value, "Matrix must be trivially copyable");
 
-Matrix::Matrix(const Matrix &M) {
-    for(int i = 0; i < 3; i++)
-        for(int j = 0; j < 3; j++)
-            this->coeffs[i][j] = M.coeffs[i][j];
+template<class T>
+MatrixT<T> MatrixT<T>::operator +() const {
+    return *this;
 }
 
-Matrix Matrix::operator +() {
-    return Matrix(*this);
-}
-
-Matrix Matrix::operator -() {
-    Matrix M;
+template<class T>
+MatrixT<T> MatrixT<T>::operator -() const {
+    MatrixT M;
     for(int i = 0; i < 3; i++)
         for(int j = 0; j < 3; j++)
             M.coeffs[i][j] = -this->coeffs[i][j];
     return M;
 }
 
-Matrix Matrix::operator +(Matrix B) {
-    Matrix M;
+template<class T>
+MatrixT<T> MatrixT<T>::operator +(const MatrixT &B) const {
+    MatrixT M;
     for(int i = 0; i < 3; i++)
         for(int j = 0; j < 3; j++)
             M.coeffs[i][j] = this->coeffs[i][j] + B.coeffs[i][j];
     return M;
 }
 
-Matrix Matrix::operator -(Matrix B) {
-    Matrix M;
+template<class T>
+MatrixT<T> MatrixT<T>::operator -(const MatrixT &B) const {
+    MatrixT M;
     for(int i = 0; i < 3; i++)
         for(int j = 0; j < 3; j++)
             M.coeffs[i][j] = this->coeffs[i][j] - B.coeffs[i][j];
     return M;
 }
 
-Matrix Matrix::operator *(Matrix B) {
-    Matrix M;
+template<class T>
+MatrixT<T> MatrixT<T>::operator *(const MatrixT &B) const {
+    MatrixT M;
     for(int i = 0; i < 3; i++)
         for(int j = 0; j < 3; j++)
             for(int k = 0; k < 3; k++)
@@ -76,10 +68,11 @@ Matrix Matrix::operator *(Matrix B) {
     return M;
 }
 
-Vector Matrix::operator *(Vector X) {
-    Vector Y;
-    double xc[3] = {X.x, X.y, X.z};
-    double yc[3] = {0., 0., 0.};
+template<class T>
+VectorT<T> MatrixT<T>::operator *(const VectorT<T> &X) const {
+    VectorT<T> Y;
+    T xc[3] = {X.x, X.y, X.z};
+    T yc[3] = {0., 0., 0.};
 
     for(int i = 0; i < 3; i++)
         for(int j = 0; j < 3; j++)
@@ -90,15 +83,17 @@ Vector Matrix::operator *(Vector X) {
     return Y;
 }
 
-double Matrix::Det() {
+template<class T>
+T MatrixT<T>::Det() const {
     return this->coeffs[0][0] * (this->coeffs[1][1] * this->coeffs[2][2] - this->coeffs[1][2] * this->coeffs[2][1])
          + this->coeffs[0][1] * (this->coeffs[2][0] * this->coeffs[1][2] - this->coeffs[1][0] * this->coeffs[2][2])
          + this->coeffs[0][2] * (this->coeffs[1][0] * this->coeffs[2][1] - this->coeffs[2][0] * this->coeffs[1][1]);
 }
 
-Matrix Matrix::Invert() {
-    Matrix M;
-    double D = this->Det();
+template<class T>
+MatrixT<T> MatrixT<T>::Invert() const {
+    MatrixT M;
+    T D = this->Det();
     M.coeffs[0][0] = 1. / D * (this->coeffs[1][1] * this->coeffs[2][2] - this->coeffs[2][1] * this->coeffs[1][2]);
     M.coeffs[0][1] = 1. / D * (this->coeffs[2][1] * this->coeffs[0][2] - this->coeffs[0][1] * this->coeffs[2][2]);
     M.coeffs[0][2] = 1. / D * (this->coeffs[0][1] * this->coeffs[1][2] - this->coeffs[1][1] * this->coeffs[0][2]);
@@ -111,7 +106,8 @@ Matrix Matrix::Invert() {
     return M;
 }
 
-void Matrix::AssignColumns(const Vector c1, const Vector c2, const Vector c3) {
+template<class T>
+void MatrixT<T>::AssignColumns(const VectorT<T> &c1, const VectorT<T> &c2, const VectorT<T> &c3) {
     this->coeffs[0][0] = c1.x;
     this->coeffs[0][1] = c2.x;
     this->coeffs[0][2] = c3.x;
@@ -123,50 +119,139 @@ void Matrix::AssignColumns(const Vector c1, const Vector c2, const Vector c3) {
     this->coeffs[2][2] = c3.z;
 }
 
-Matrix Matrix::Diag(const Vector v) {
-    Matrix M;
+template<class T>
+MatrixT<T> MatrixT<T>::Diag(const VectorT<T> &v) {
+    MatrixT M;
     M.coeffs[0][0] = v.x;
     M.coeffs[1][1] = v.y;
     M.coeffs[2][2] = v.z;
     return M;
 }
 
-Matrix Matrix::RotationYPR(const Vector angles) {
-    Matrix Mx, My, Mz;
-    double c, s;
+/*
+ * Rz(z) Ry(y) Rx(x) in closed form, each coefficient summed in the order
+ * the three matrix products would use
+ */
+template<class T>
+MatrixT<T> MatrixT<T>::RotationYPR(const VectorT<T> &angles) {
+    T cx = std::cos(angles.x), sx = std::sin(angles.x);
+    T cy = std::cos(angles.y), sy = std::sin(angles.y);
+    T cz = std::cos(angles.z), sz = std::sin(angles.z);
+    MatrixT R;
+
+    R.coeffs[0][0] = cz * cy;
+    R.coeffs[0][1] = -sz * cx + cz * sy * sx;
+    R.coeffs[0][2] = sz * sx + cz * sy * cx;
+    R.coeffs[1][0] = sz * cy;
+    R.coeffs[1][1] = cz * cx + sz * sy * sx;
+    R.coeffs[1][2] = -cz * sx + sz * sy * cx;
+    R.coeffs[2][0] = -sy;
+    R.coeffs[2][1] = cy * sx;
+    R.coeffs[2][2] = cy * cx;
 
-    c = std::cos(angles.x);
-    s = std::sin(angles.x);
-    Mx.AssignColumns(Vector(1, 0, 0), Vector(0, c, s), Vector(0, -s, c));
+    return R;
+}
 
-    c = std::cos(angles.y);
-    s = std::sin(angles.y);
-    My.AssignColumns(Vector(c, 0, -s), Vector(0, 1, 0), Vector(s, 0, c));
+/*
+ * Rodrigues' formula: R = c I + s [k]x + (1 - c) k k^T, k = axis / |axis|
+ */
+template<class T>
+MatrixT<T> MatrixT<T>::Rotation(T angle, const VectorT<T> &axis) {
+    VectorT<T> k = (T)(1. / axis.norm()) * axis;
+    T c = std::cos(angle), s = std::sin(angle);
+    MatrixT R;
 
-    c = std::cos(angles.z);
-    s = std::sin(angles.z);
-    Mz.AssignColumns(Vector(c, s, 0), Vector(-s, c, 0), Vector(0, 0, 1));
+    R.coeffs[0][0] = c + (1 - c) * k.x * k.x;
+    R.coeffs[0][1] = -s * k.z + (1 - c) * k.x * k.y;
+    R.coeffs[0][2] = s * k.y + (1 - c) * k.x * k.z;
+    R.coeffs[1][0] = s * k.z + (1 - c) * k.y * k.x;
+    R.coeffs[1][1] = c + (1 - c) * k.y * k.y;
+    R.coeffs[1][2] = -s * k.x + (1 - c) * k.y * k.z;
+    R.coeffs[2][0] = -s * k.y + (1 - c) * k.z * k.x;
+    R.coeffs[2][1] = s * k.x + (1 - c) * k.z * k.y;
+    R.coeffs[2][2] = c + (1 - c) * k.z * k.z;
 
-    return Mz * My * Mx;
+    return R;
 }
 
-std::string *Matrix::dump() {
+template<class T>
+std::string *MatrixT<T>::dump() const {
     std::string *S = new std::string[3];
-    char buf[25];
+    char buf[64];
 
     for(int i = 0; i < 3; i++) {
-        std::sprintf(buf, "%7g %7g %7g", this->coeffs[i][0], this->coeffs[i][1], this->coeffs[i][2]);
+        std::snprintf(buf, sizeof(buf), "%7g %7g %7g", this->coeffs[i][0], this->coeffs[i][1], this->coeffs[i][2]);
         S[i] = buf;
     }
 
     return S;
 }
 
-Matrix operator *(double k, Matrix M) {
-    Matrix R;
+template<class T>
+static MatrixT<T> scale(T k, const MatrixT<T> &M) {
+    MatrixT<T> R;
     for(int i = 0; i < 3; i++)
         for(int j = 0; j < 3; j++)
             R.coeffs[i][j] = k * M.coeffs[i][j];
     return R;
 }
 
+
+Matrix operator *(double k, const Matrix &M) {
+    return scale(k, M);
+}
+
+Matrixf operator *(float k, const Matrixf &M) {
+    return scale(k, M);
+}
+
+template<class T>
+AffineT<T>::AffineT(): M(MatrixT<T>::Diag(VectorT<T>(1, 1, 1))), t() {}
+
+template<class T>
+AffineT<T>::AffineT(const MatrixT<T> &M, const VectorT<T> &t): M(M), t(t) {}
+
+template<class T>
+AffineT<T> AffineT<T>::operator *(const AffineT &B) const {
+    return AffineT(this->M * B.M, this->M * B.t + this->t);
+}
+
+template<class T>
+PointT<T> AffineT<T>::apply_point(const PointT<T> &P) const {
+    return this->M * P + this->t;
+}
+
+template<class T>
+VectorT<T> AffineT<T>::apply_vector(const VectorT<T> &V) const {
+    return this->M * V;
+}
+
+template<class T>
+AffineT<T> AffineT<T>::Translation(const VectorT<T> &v) {
+    return AffineT(MatrixT<T>::Diag(VectorT<T>(1, 1, 1)), v);
+}
+
+template<class T>
+AffineT<T> AffineT<T>::Linear(const MatrixT<T> &M) {
+    return AffineT(M, VectorT<T>());
+}
+
+template<class T>
+AffineT<T> AffineT<T>::Scale(const VectorT<T> &k) {
+    return Linear(MatrixT<T>::Diag(k));
+}
+
+template<class T>
+AffineT<T> AffineT<T>::RotationYPR(const VectorT<T> &angles) {
+    return Linear(MatrixT<T>::RotationYPR(angles));
+}
+
+template<class T>
+AffineT<T> AffineT<T>::Rotation(T angle, const VectorT<T> &axis) {
+    return Linear(MatrixT<T>::Rotation(angle, axis));
+}
+
+template class MatrixT<double>;
+template class MatrixT<float>;
+template class AffineT<double>;
+template class AffineT<float>;
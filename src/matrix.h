@@ -25,35 +25,76 @@
 
 #include "geometry.h"
 
-class Matrix {
+template<class T = double>
+class MatrixT {
 public:
-    double coeffs[3][3];
+    T coeffs[3][3];
 
-    Matrix();
-    Matrix(const Vector c1, const Vector c2, const Vector c3);
-    Matrix(const Matrix &M);
+    constexpr MatrixT(): coeffs{{0, 0, 0}, {0, 0, 0}, {0, 0, 0}} {}
+    constexpr MatrixT(const VectorT<T> &c1, const VectorT<T> &c2, const VectorT<T> &c3):
+        coeffs{{c1.x, c2.x, c3.x}, {c1.y, c2.y, c3.y}, {c1.z, c2.z, c3.z}} {}
 
-    Matrix operator +();
-    Matrix operator -();
+    template<class U>
+    explicit MatrixT(const MatrixT<U> &M) {
+        for(int i = 0; i < 3; i++)
+            for(int j = 0; j < 3; j++)
+                this->coeffs[i][j] = M.coeffs[i][j];
+    }
 
-    Matrix operator +(Matrix B);
-    Matrix operator -(Matrix B);
-    Matrix operator *(Matrix B);
+    MatrixT operator +() const;
+    MatrixT operator -() const;
 
-    Vector operator *(Vector X);
+    MatrixT operator +(const MatrixT &B) const;
+    MatrixT operator -(const MatrixT &B) const;
+    MatrixT operator *(const MatrixT &B) const;
 
-    double Det();
-    Matrix Invert();
+    VectorT<T> operator *(const VectorT<T> &X) const;
 
-    void AssignColumns(const Vector c1, const Vector c2, const Vector c3);
+    T Det() const;
+    MatrixT Invert() const;
+
+    void AssignColumns(const VectorT<T> &c1, const VectorT<T> &c2, const VectorT<T> &c3);
     
-    static Matrix Diag(const Vector v);
-    static Matrix RotationYPR(const Vector angles);
+    static MatrixT Diag(const VectorT<T> &v);
+    static MatrixT RotationYPR(const VectorT<T> &angles);
+    static MatrixT Rotation(T angle, const VectorT<T> &axis);
+
+    std::string *dump() const;
+};
+
+typedef MatrixT<double> Matrix;
+typedef MatrixT<float> Matrixf;
+
+Matrix operator *(double k, const Matrix &M);
+Matrixf operator *(float k, const Matrixf &M);
+
+/*
+ * Affine map x -> M x + t. Composition follows the matrix product: (A * B)
+ * applies B first, so a chain of transforms folds into a single map.
+ */
+template<class T = double>
+class AffineT {
+public:
+    MatrixT<T> M;
+    VectorT<T> t;
+
+    AffineT();
+    AffineT(const MatrixT<T> &M, const VectorT<T> &t);
+
+    AffineT operator *(const AffineT &B) const;
+
+    PointT<T> apply_point(const PointT<T> &P) const;
+    VectorT<T> apply_vector(const VectorT<T> &V) const;
 
-    std::string *dump();
+    static AffineT Translation(const VectorT<T> &v);
+    static AffineT Linear(const MatrixT<T> &M);
+    static AffineT Scale(const VectorT<T> &k);
+    static AffineT RotationYPR(const VectorT<T> &angles);
+    static AffineT Rotation(T angle, const VectorT<T> &axis);
 };
 
-Matrix operator *(double k, Matrix M);
+typedef AffineT<double> Affine;
+typedef AffineT<float> Affinef;
 
 #endif
 
@@ -0,0 +1,558 @@
+/*
+ * mesh_io.cxx - Mesh file output
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mesh_io.h"
+
+#define STL_HEADER_SIZE 84
+#define STL_FACET_SIZE 50
+#define STL_BUFFER_SIZE (STL_FACET_SIZE * 20000)
+
+static inline char *put_u32(char *p, unsigned int v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+    return p + 4;
+}
+
+static inline char *put_float(char *p, float f) {
+    unsigned int v;
+    std::memcpy(&v, &f, 4);
+    return put_u32(p, v);
+}
+
+static bool write_all(int fd, const char *p, size_t len) {
+    while(len > 0) {
+        ssize_t r = ::write(fd, p, len);
+        if(r < 0) {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+STLWriter::STLWriter(int fd) {
+    this->fd = fd;
+    this->buf = new char[STL_BUFFER_SIZE];
+    this->used = 0;
+    this->start = -1;
+    this->declared = this->written = 0;
+    this->ok = true;
+}
+
+STLWriter::~STLWriter() {
+    delete[] this->buf;
+}
+
+size_t STLWriter::FileSize(size_t ntriangles) {
+    return STL_HEADER_SIZE + STL_FACET_SIZE * ntriangles;
+}
+
+static void put_header(char *header, const char *name, unsigned int ntriangles) {
+    // The header must not start with "solid", or readers take it for ASCII
+    std::memset(header, 0, STL_HEADER_SIZE);
+    std::strncpy(header, "binary ", 80);
+    if(name != NULL)
+        std::strncat(header, name, 80 - std::strlen(header));
+    put_u32(header + 80, ntriangles);
+}
+
+bool STLWriter::begin(const char *name, unsigned int ntriangles) {
+    char header[STL_HEADER_SIZE];
+
+    put_header(header, name, ntriangles);
+    this->declared = ntriangles;
+    this->written = 0;
+    this->start = ::lseek(this->fd, 0, SEEK_CUR);
+
+    this->ok = write_all(this->fd, header, STL_HEADER_SIZE);
+    return this->ok;
+}
+
+/*
+ * Facet record: float normal, three float vertices and a zero attribute
+ */
+template<class T>
+static void put_facet(char *p, const PointT<T> *P) {
+    float ux = P[1].x - P[0].x, uy = P[1].y - P[0].y, uz = P[1].z - P[0].z;
+    float vx = P[2].x - P[0].x, vy = P[2].y - P[0].y, vz = P[2].z - P[0].z;
+    float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+    float l = nx * nx + ny * ny + nz * nz;
+
+    if(l > 0.f) {
+        l = 1.f / std::sqrt(l);
+        nx *= l;
+        ny *= l;
+        nz *= l;
+    }
+
+    p = put_float(p, nx);
+    p = put_float(p, ny);
+    p = put_float(p, nz);
+    for(int i = 0; i < 3; i++) {
+        p = put_float(p, P[i].x);
+        p = put_float(p, P[i].y);
+        p = put_float(p, P[i].z);
+    }
+    p[0] = p[1] = 0;
+}
+
+bool STLWriter::add(const Triangle &T) {
+    if(this->used + STL_FACET_SIZE > STL_BUFFER_SIZE && !this->flush())
+        return false;
+
+    put_facet(this->buf + this->used, T.points);
+    this->used += STL_FACET_SIZE;
+    this->written++;
+    return true;
+}
+
+bool STLWriter::add(const Trianglef &T) {
+    if(this->used + STL_FACET_SIZE > STL_BUFFER_SIZE && !this->flush())
+        return false;
+
+    put_facet(this->buf + this->used, T.points);
+    this->used += STL_FACET_SIZE;
+    this->written++;
+    return true;
+}
+
+void STLWriter::put(const Triangle *triangles, size_t n) {
+    for(size_t i = 0; i < n && this->ok; i++)
+        this->add(triangles[i]);
+}
+
+bool STLWriter::good() {
+    return this->ok;
+}
+
+bool STLWriter::flush() {
+    if(this->ok && this->used > 0)
+        this->ok = write_all(this->fd, this->buf, this->used);
+    this->used = 0;
+    return this->ok;
+}
+
+bool STLWriter::finish() {
+    if(!this->flush() || this->written == this->declared)
+        return this->ok;
+
+    // Fewer triangles than announced, typically from a simplified extrusion
+    char count[4];
+    put_u32(count, this->written);
+    this->ok = this->start >= 0 && ::pwrite(this->fd, count, 4, this->start + 80) == 4;
+    return this->ok;
+}
+
+template<class T>
+static bool write_mesh(int fd, const char *name, const MeshT<T> &mesh) {
+    STLWriter writer(fd);
+
+    if(!writer.begin(name, mesh.faces.size()))
+        return false;
+
+    for(size_t i = 0; i < mesh.faces.size(); i++)
+        if(!writer.add(mesh.triangle(i)))
+            return false;
+
+    return writer.finish();
+}
+
+bool write_stl_binary(int fd, const char *name, const Mesh &mesh) {
+    return write_mesh(fd, name, mesh);
+}
+
+bool write_stl_binary(int fd, const char *name, const Meshf &mesh) {
+    return write_mesh(fd, name, mesh);
+}
+
+bool write_stl_binary(int fd, const char *name, const Object &obj) {
+    STLWriter writer(fd);
+
+    if(!writer.begin(name, obj.size()))
+        return false;
+
+    for(Object::const_iterator it = obj.begin(); it != obj.end(); it++)
+        if(!writer.add(*it))
+            return false;
+
+    return writer.finish();
+}
+
+// Create the file and hand its descriptor to one of the writers
+template<class T>
+static bool write_mesh_file(bool (*writer)(int, const char *, const MeshT<T> &), const char *fname, const char *name, const MeshT<T> &mesh) {
+    int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+    if(fd < 0)
+        return false;
+
+    bool ok = writer(fd, name, mesh);
+    if(close(fd) < 0)
+        ok = false;
+
+    return ok;
+}
+
+bool write_stl_binary(const char *fname, const char *name, const Mesh &mesh) {
+    return write_mesh_file(write_stl_binary, fname, name, mesh);
+}
+
+bool write_stl_binary(const char *fname, const char *name, const Meshf &mesh) {
+    return write_mesh_file(write_stl_binary, fname, name, mesh);
+}
+
+// Longest text record of the OFF and OBJ writers
+#define TEXT_RECORD_SIZE 128
+
+#define PLY_VERTEX_SIZE 12
+#define PLY_FACE_SIZE 13
+
+/*
+ * Output through a large buffer flushed with a few write() calls, for the
+ * writers which produce records of varying size
+ */
+class OutputBuffer {
+public:
+    OutputBuffer(int fd): fd(fd), buf(new char[STL_BUFFER_SIZE]), used(0), ok(true) {}
+    ~OutputBuffer() { delete[] this->buf; }
+
+    // Room for a record of at most len bytes, to be committed once written
+    char *reserve(size_t len) {
+        if(this->used + len > STL_BUFFER_SIZE)
+            this->flush();
+        return this->buf + this->used;
+    }
+
+    void commit(size_t len) {
+        this->used += len;
+    }
+
+    void append(const std::string &s) {
+        this->flush();
+        if(this->ok)
+            this->ok = write_all(this->fd, s.data(), s.size());
+    }
+
+    bool flush() {
+        if(this->ok && this->used > 0)
+            this->ok = write_all(this->fd, this->buf, this->used);
+        this->used = 0;
+        return this->ok;
+    }
+
+private:
+    int fd;
+    char *buf;
+    size_t used;
+    bool ok;
+
+    OutputBuffer(const OutputBuffer &);
+    OutputBuffer &operator =(const OutputBuffer &);
+};
+
+static std::string ply_header(const char *name, size_t nvertices, size_t nfaces) {
+    char counts[128];
+    std::string h("ply\nformat binary_little_endian 1.0\n");
+
+    if(name != NULL)
+        h += std::string("comment ") + name + "\n";
+    std::snprintf(counts, sizeof(counts), "element vertex %zu\n", nvertices);
+    h += counts;
+    h += "property float x\nproperty float y\nproperty float z\n";
+    std::snprintf(counts, sizeof(counts), "element face %zu\n", nfaces);
+    h += counts;
+    h += "property list uchar uint vertex_indices\nend_header\n";
+
+    return h;
+}
+
+template<class T>
+static inline void put_ply_vertex(char *p, const PointT<T> &P) {
+    p = put_float(p, P.x);
+    p = put_float(p, P.y);
+    put_float(p, P.z);
+}
+
+static inline void put_ply_face(char *p, const Face &F) {
+    *p++ = 3;
+    for(int k = 0; k < 3; k++)
+        p = put_u32(p, F.indices[k]);
+}
+
+template<class T>
+static bool write_ply_mesh(int fd, const char *name, const MeshT<T> &mesh) {
+    OutputBuffer out(fd);
+
+    out.append(ply_header(name, mesh.vertices.size(), mesh.faces.size()));
+
+    for(size_t i = 0; i < mesh.vertices.size(); i++) {
+        put_ply_vertex(out.reserve(PLY_VERTEX_SIZE), mesh.vertices[i]);
+        out.commit(PLY_VERTEX_SIZE);
+    }
+    for(size_t i = 0; i < mesh.faces.size(); i++) {
+        put_ply_face(out.reserve(PLY_FACE_SIZE), mesh.faces[i]);
+        out.commit(PLY_FACE_SIZE);
+    }
+
+    return out.flush();
+}
+
+bool write_ply_binary(int fd, const char *name, const Mesh &mesh) {
+    return write_ply_mesh(fd, name, mesh);
+}
+
+bool write_ply_binary(int fd, const char *name, const Meshf &mesh) {
+    return write_ply_mesh(fd, name, mesh);
+}
+
+bool write_ply_binary(const char *fname, const char *name, const Mesh &mesh) {
+    return write_mesh_file(write_ply_binary, fname, name, mesh);
+}
+
+bool write_ply_binary(const char *fname, const char *name, const Meshf &mesh) {
+    return write_mesh_file(write_ply_binary, fname, name, mesh);
+}
+
+/*
+ * Text records: vertices with the digits needed to read back the same
+ * value, faces with indices starting at base
+ */
+template<class T>
+static void put_text_vertex(OutputBuffer &out, const char *prefix, const PointT<T> &P) {
+    int digits = std::numeric_limits<T>::max_digits10;
+    int len = std::snprintf(out.reserve(TEXT_RECORD_SIZE), TEXT_RECORD_SIZE, "%s%.*g %.*g %.*g\n",
+                            prefix, digits, (double)P.x, digits, (double)P.y, digits, (double)P.z);
+    out.commit(len);
+}
+
+static void put_text_face(OutputBuffer &out, const char *prefix, const Face &F, unsigned int base) {
+    const unsigned int *v = F.indices;
+    int len = std::snprintf(out.reserve(TEXT_RECORD_SIZE), TEXT_RECORD_SIZE, "%s%u %u %u\n", prefix, v[0] + base, v[1] + base, v[2] + base);
+    out.commit(len);
+}
+
+template<class T>
+static bool write_off_mesh(int fd, const char *name, const MeshT<T> &mesh) {
+    OutputBuffer out(fd);
+    std::string header("OFF\n");
+    char counts[64];
+
+    if(name != NULL)
+        header += std::string("# ") + name + "\n";
+    std::snprintf(counts, sizeof(counts), "%zu %zu 0\n", mesh.vertices.size(), mesh.faces.size());
+    out.append(header + counts);
+
+    for(size_t i = 0; i < mesh.vertices.size(); i++)
+        put_text_vertex(out, "", mesh.vertices[i]);
+    for(size_t i = 0; i < mesh.faces.size(); i++)
+        put_text_face(out, "3 ", mesh.faces[i], 0);
+
+    return out.flush();
+}
+
+bool write_off(int fd, const char *name, const Mesh &mesh) {
+    return write_off_mesh(fd, name, mesh);
+}
+
+bool write_off(int fd, const char *name, const Meshf &mesh) {
+    return write_off_mesh(fd, name, mesh);
+}
+
+bool write_off(const char *fname, const char *name, const Mesh &mesh) {
+    return write_mesh_file(write_off, fname, name, mesh);
+}
+
+bool write_off(const char *fname, const char *name, const Meshf &mesh) {
+    return write_mesh_file(write_off, fname, name, mesh);
+}
+
+// OBJ indices start at 1
+template<class T>
+static bool write_obj_mesh(int fd, const char *name, const MeshT<T> &mesh) {
+    OutputBuffer out(fd);
+
+    if(name != NULL)
+        out.append(std::string("o ") + name + "\n");
+
+    for(size_t i = 0; i < mesh.vertices.size(); i++)
+        put_text_vertex(out, "v ", mesh.vertices[i]);
+    for(size_t i = 0; i < mesh.faces.size(); i++)
+        put_text_face(out, "f ", mesh.faces[i], 1);
+
+    return out.flush();
+}
+
+bool write_obj(int fd, const char *name, const Mesh &mesh) {
+    return write_obj_mesh(fd, name, mesh);
+}
+
+bool write_obj(int fd, const char *name, const Meshf &mesh) {
+    return write_obj_mesh(fd, name, mesh);
+}
+
+bool write_obj(const char *fname, const char *name, const Mesh &mesh) {
+    return write_mesh_file(write_obj, fname, name, mesh);
+}
+
+bool write_obj(const char *fname, const char *name, const Meshf &mesh) {
+    return write_mesh_file(write_obj, fname, name, mesh);
+}
+
+STLMapping::STLMapping() {
+    this->fd = -1;
+    this->map = NULL;
+    this->size = 0;
+}
+
+STLMapping::~STLMapping() {
+    if(this->map != NULL)
+        munmap(this->map, this->size);
+    if(this->fd >= 0)
+        close(this->fd);
+}
+
+/*
+ * Create a file of the given size and map it, NULL on failure. The blocks
+ * of the whole file are reserved up front, so that running out of space
+ * fails here rather than with SIGBUS on a write to the mapping.
+ */
+static char *map_file(const char *fname, size_t size, int &fd) {
+    fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return NULL;
+
+    // Some file systems cannot reserve blocks: only size the file there
+    int err = posix_fallocate(fd, 0, size);
+    if(err == EINVAL || err == EOPNOTSUPP)
+        err = ftruncate(fd, size) < 0 ? errno : 0;
+    if(err != 0)
+        return NULL;
+
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return p != MAP_FAILED ? (char *)p : NULL;
+}
+
+bool STLMapping::open(const char *fname, const char *name, size_t ntriangles) {
+    this->size = STLWriter::FileSize(ntriangles);
+    this->map = map_file(fname, this->size, this->fd);
+    if(this->map == NULL)
+        return false;
+
+    put_header(this->map, name, ntriangles);
+    return true;
+}
+
+void STLMapping::put(size_t index, const Triangle *triangles, size_t n) {
+    char *p = this->map + STLWriter::FileSize(index);
+
+    for(size_t i = 0; i < n; i++, p += STL_FACET_SIZE)
+        put_facet(p, triangles[i].points);
+}
+
+bool STLMapping::finish(size_t ntriangles) {
+    size_t size = STLWriter::FileSize(ntriangles);
+    bool ok = this->map != NULL;
+
+    if(ok && size < this->size)
+        put_u32(this->map + 80, ntriangles);
+
+    if(this->map != NULL && munmap(this->map, this->size) < 0)
+        ok = false;
+    this->map = NULL;
+
+    if(ok && size < this->size && ftruncate(this->fd, size) < 0)
+        ok = false;
+    if(this->fd >= 0 && close(this->fd) < 0)
+        ok = false;
+    this->fd = -1;
+
+    return ok;
+}
+
+PLYMapping::PLYMapping() {
+    this->fd = -1;
+    this->map = NULL;
+    this->size = this->header = this->nvertices = 0;
+}
+
+PLYMapping::~PLYMapping() {
+    if(this->map != NULL)
+        munmap(this->map, this->size);
+    if(this->fd >= 0)
+        close(this->fd);
+}
+
+bool PLYMapping::open(const char *fname, const char *name, size_t nvertices, size_t nfaces) {
+    std::string h = ply_header(name, nvertices, nfaces);
+
+    this->header = h.size();
+    this->nvertices = nvertices;
+    this->size = this->header + PLY_VERTEX_SIZE * nvertices + PLY_FACE_SIZE * nfaces;
+    this->map = map_file(fname, this->size, this->fd);
+    if(this->map == NULL)
+        return false;
+
+    std::memcpy(this->map, h.data(), h.size());
+    return true;
+}
+
+void PLYMapping::put_vertices(size_t index, const Point *vertices, size_t n) {
+    char *p = this->map + this->header + PLY_VERTEX_SIZE * index;
+
+    for(size_t i = 0; i < n; i++, p += PLY_VERTEX_SIZE)
+        put_ply_vertex(p, vertices[i]);
+}
+
+void PLYMapping::put_faces(size_t index, const Face *faces, size_t n) {
+    char *p = this->map + this->header + PLY_VERTEX_SIZE * this->nvertices + PLY_FACE_SIZE * index;
+
+    for(size_t i = 0; i < n; i++, p += PLY_FACE_SIZE)
+        put_ply_face(p, faces[i]);
+}
+
+bool PLYMapping::finish() {
+    bool ok = this->map != NULL;
+
+    if(this->map != NULL && munmap(this->map, this->size) < 0)
+        ok = false;
+    this->map = NULL;
+
+    if(this->fd >= 0 && close(this->fd) < 0)
+        ok = false;
+    this->fd = -1;
+
+    return ok;
+}
@@ -0,0 +1,144 @@
+/*
+ * mesh_io.h - Mesh file output
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_MESH_IO_H_
+#define _I_MESH_IO_H_
+
+#include <cstddef>
+
+#include <sys/types.h>
+
+#include "geometry.h"
+
+/*
+ * Buffered binary STL writer. The triangle count goes in the header, so
+ * it has to be known before the first triangle is added; triangles are
+ * packed into a large buffer and flushed with a few write() calls.
+ * When a different number was added, finish() rewrites the count in the
+ * header, which needs a seekable file descriptor.
+ */
+class STLWriter: public TriangleSink {
+public:
+    STLWriter(int fd);
+    ~STLWriter();
+
+    bool begin(const char *name, unsigned int ntriangles);
+    bool add(const Triangle &T);
+    bool add(const Trianglef &T);
+    bool finish();
+
+    void put(const Triangle *triangles, size_t n);
+    bool good();
+
+    static size_t FileSize(size_t ntriangles);
+
+private:
+    int fd;
+    char *buf;
+    size_t used;
+    off_t start;
+    unsigned int declared, written;
+    bool ok;
+
+    bool flush();
+
+    STLWriter(const STLWriter &);
+    STLWriter &operator =(const STLWriter &);
+};
+
+/*
+ * Binary STL file of known size mapped in memory. Facets are written in
+ * place at any index, from any number of threads, with no buffering.
+ */
+class STLMapping {
+public:
+    STLMapping();
+    ~STLMapping();
+
+    bool open(const char *fname, const char *name, size_t ntriangles);
+
+    // Write triangles as facets [index, index + n)
+    void put(size_t index, const Triangle *triangles, size_t n);
+
+    // Unmap and close, cutting the file down to ntriangles facets when
+    // fewer than reserved were written
+    bool finish(size_t ntriangles);
+
+private:
+    int fd;
+    char *map;
+    size_t size;
+
+    STLMapping(const STLMapping &);
+    STLMapping &operator =(const STLMapping &);
+};
+
+bool write_stl_binary(int fd, const char *name, const Mesh &mesh);
+bool write_stl_binary(int fd, const char *name, const Meshf &mesh);
+bool write_stl_binary(int fd, const char *name, const Object &obj);
+bool write_stl_binary(const char *fname, const char *name, const Mesh &mesh);
+bool write_stl_binary(const char *fname, const char *name, const Meshf &mesh);
+
+/*
+ * Indexed formats: each vertex is written once and faces as triples of
+ * indices, in the order of the mesh. PLY is binary little endian with
+ * float coordinates; OFF and OBJ are text, with as many digits as the
+ * vertex type needs to read back the same values.
+ */
+bool write_ply_binary(int fd, const char *name, const Mesh &mesh);
+bool write_ply_binary(int fd, const char *name, const Meshf &mesh);
+bool write_ply_binary(const char *fname, const char *name, const Mesh &mesh);
+bool write_ply_binary(const char *fname, const char *name, const Meshf &mesh);
+bool write_off(int fd, const char *name, const Mesh &mesh);
+bool write_off(int fd, const char *name, const Meshf &mesh);
+bool write_off(const char *fname, const char *name, const Mesh &mesh);
+bool write_off(const char *fname, const char *name, const Meshf &mesh);
+bool write_obj(int fd, const char *name, const Mesh &mesh);
+bool write_obj(int fd, const char *name, const Meshf &mesh);
+bool write_obj(const char *fname, const char *name, const Mesh &mesh);
+bool write_obj(const char *fname, const char *name, const Meshf &mesh);
+
+/*
+ * Binary PLY file of known vertex and face counts mapped in memory, the
+ * indexed counterpart of STLMapping
+ */
+class PLYMapping {
+public:
+    PLYMapping();
+    ~PLYMapping();
+
+    bool open(const char *fname, const char *name, size_t nvertices, size_t nfaces);
+
+    // Write vertices [index, index + n) and faces [index, index + n)
+    void put_vertices(size_t index, const Point *vertices, size_t n);
+    void put_faces(size_t index, const Face *faces, size_t n);
+
+    bool finish();
+
+private:
+    int fd;
+    char *map;
+    size_t size, header, nvertices;
+
+    PLYMapping(const PLYMapping &);
+    PLYMapping &operator =(const PLYMapping &);
+};
+
+#endif
@@ -18,83 +18,2106 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "arena.h"
 #include "geometry.h"
 #include "matrix.h"
+#include "mesh_io.h"
 #include "path_extrude.h"
+#include "task_pool.h"
+#include "transform.h"
+#include "triangulate.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
 
-Object path_extrude(Polygon poly, Path path, Path guide, bool close_ends) {
-    Object obj;
-    Polygon refpoly, oldp;
+/*
+ * Statistics are only gathered when a record is passed in the options;
+ * defining PATH_EXTRUDE_NO_STATS compiles them out altogether.
+ */
+#ifdef PATH_EXTRUDE_NO_STATS
+#define STATS(opts) ((ExtrudeStats *)NULL)
+#else
+#define STATS(opts) ((opts).stats)
+#endif
+
+static inline double stats_clock() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Account for a buffer allocated by the extrusion
+template<class T>
+static inline void stats_alloc(ExtrudeStats *stats, const std::vector<T> &v) {
+    if(stats != NULL && v.capacity() > 0) {
+        stats->allocations++;
+        stats->bytes += v.capacity() * sizeof(T);
+    }
+}
+
+// Account for the blocks the arena obtained from the system since a snapshot
+static inline void stats_arena(ExtrudeStats *stats, const Arena &arena, size_t blocks, size_t capacity) {
+    if(stats != NULL) {
+        stats->allocations += arena.blocks() - blocks;
+        stats->bytes += arena.capacity() - capacity;
+    }
+}
+
+// Strips computed by each worker between two calls to the sink
+#define SINK_STRIPS_PER_THREAD 64
+
+// Ring vertices computed at once by each worker of a streaming extrusion
+#define SINK_BLOCK 4096
+
+/*
+ * Polygon coordinates in the frame of the first path sample, stored as
+ * separate arrays for the batched transform kernel, in both precisions
+ */
+class RefPolygon {
+public:
+    double *x, *y, *z;
+    float *xf, *yf, *zf;
+    size_t n;
+
+    size_t size() const { return this->n; }
+
+    void transform(const Matrix &P, const Point &t, Point *out) const {
+        transform_points(P, t, this->x, this->y, this->z, this->n, out);
+    }
+
+    void transform(const Matrix &P, const Point &t, Pointf *out) const {
+        transform_points(P, t, this->xf, this->yf, this->zf, this->n, out);
+    }
+};
+
+// Samples fetched at once from a source when computing a run of rings
+#define SAMPLE_BLOCK 256
+
+/*
+ * Room for a block of samples, left uninitialized: clearing it would cost
+ * more than computing a single ring, and sources fill what they return
+ */
+class SampleBuffer {
+public:
+    union {
+        PathSample samples[SAMPLE_BLOCK];
+    };
+
+    SampleBuffer() {}
+};
+
+/*
+ * Random access to the samples of a path, either stored or generated
+ */
+class SampleSource {
+public:
+    virtual ~SampleSource() {}
+
+    virtual size_t size() const = 0;
+
+    // Samples [begin, end), possibly computed into buf
+    virtual const PathSample *fetch(size_t begin, size_t end, PathSample *buf) const = 0;
+
+    // The source this one picks its samples from, and the index there of sample k
+    virtual const SampleSource &dense() const { return *this; }
+    virtual size_t index(size_t k) const { return k; }
+};
+
+class StoredSource: public SampleSource {
+public:
+    const Path &path;
+
+    StoredSource(const Path &p): path(p) {}
+
+    size_t size() const {
+        return this->path.size();
+    }
+
+    const PathSample *fetch(size_t begin, size_t end, PathSample *buf) const {
+        return &this->path[begin];
+    }
+};
+
+class LazySource: public SampleSource {
+public:
+    const LazyPath &path;
+
+    LazySource(const LazyPath &p): path(p) {}
+
+    size_t size() const {
+        return this->path.size();
+    }
+
+    const PathSample *fetch(size_t begin, size_t end, PathSample *buf) const {
+        this->path.eval(begin, end, buf);
+        return buf;
+    }
+};
+
+/*
+ * Every 2^lod-th sample of another source, and always its last one, so
+ * that each level of detail holds the samples of the coarser ones
+ */
+class StridedSource: public SampleSource {
+public:
+    const SampleSource &base;
+    size_t stride;
+
+    StridedSource(const SampleSource &base, int lod): base(base), stride((size_t)1 << std::max(lod, 0)) {}
+
+    size_t size() const {
+        size_t m = this->base.size();
+        return m > 0 ? (m + this->stride - 2) / this->stride + 1 : 0;
+    }
+
+    /*
+     * The base samples are fetched by runs of up to SAMPLE_BLOCK, which
+     * are picked from: generating a lazy path one sample at a time costs
+     * several times more than generating a run of them
+     */
+    const PathSample *fetch(size_t begin, size_t end, PathSample *buf) const {
+        if(this->stride == 1)
+            return this->base.fetch(begin, end, buf);
+
+        SampleBuffer run;
+        size_t last = this->base.size() - 1, per_run = (SAMPLE_BLOCK - 1) / this->stride + 1;
+
+        for(size_t k = begin; k < end;) {
+            size_t run_end = std::min(end, k + per_run);
+            size_t i0 = std::min(k * this->stride, last), i1 = std::min((run_end - 1) * this->stride, last) + 1;
+            const PathSample *smp = this->base.fetch(i0, i1, run.samples);
+
+            for(; k < run_end; k++)
+                buf[k - begin] = smp[std::min(k * this->stride, last) - i0];
+        }
+        return buf;
+    }
+
+    const SampleSource &dense() const {
+        return this->base.dense();
+    }
+
+    size_t index(size_t k) const {
+        return this->base.index(std::min(k * this->stride, this->base.size() - 1));
+    }
+};
+
+// Vertices computed by each subtask of a batch
+#define BATCH_GRAIN 16384
+
+/*
+ * Ring generator: holds the reference polygon and the path and guide
+ * sources, and computes any range of rings independently. Without a guide,
+ * the X axis of every frame is precomputed as a rotation-minimizing frame.
+ */
+class Extruder {
+public:
+    const SampleSource &path, &guide;
+    RefPolygon refpoly;
+    const Vector *axes;
+
+    // Winding of the polygon around the path tangent
+    bool ccw;
+    // Triangulation of the polygon, with its winding
+    std::vector<Face> cap;
+    // Reference frame: first path sample and inverse of its frame
+    Point ref_origin;
+    Matrix ref_inverse;
+
+    Extruder(const Polygon &poly, const SampleSource &path, const SampleSource &guide, double twist, Arena &arena);
+    Extruder(const Polygon &poly, const SampleSource &path, const SampleSource &guide, const Vector *axes, Arena &arena);
+    Extruder(const Extruder &full, const Polygon &poly, const std::vector<unsigned int> &columns, const SampleSource &path, const SampleSource &guide, Arena &arena);
+
+    void set_polygon(const Polygon &poly, Arena &arena);
+    void frame(const PathSample &path_smp, const Vector &X, Matrix &P) const;
+    template<class T>
+    void rings(size_t begin, size_t end, PointT<T> *out, ExtrudeStats *stats = NULL) const;
+
+    void strip(const Point *oldp, const Point *newp, Triangle *out) const;
+    void strip_faces(unsigned int oldp, unsigned int newp, Face *out) const;
+    size_t welded_strip(const Point *oldp, const Point *newp, Triangle *out) const;
+    size_t welded_strip_faces(const unsigned int *oldp, const unsigned int *newp, Face *out) const;
+    void cap_triangles(const Point *ring, bool end, Triangle *out) const;
+    void cap_faces(unsigned int ring, bool end, Face *out) const;
+    void welded_cap_faces(const unsigned int *ring, bool end, Face *out) const;
+};
+
+/*
+ * Twice the signed area of the polygon projected on the (X, Y) plane of
+ * the reference frame, positive if it turns counter-clockwise around Z
+ */
+static double polygon_orientation(const RefPolygon &refpoly) {
+    size_t n = refpoly.size();
+    double a = 0.;
+
+    for(size_t i = 0, j = n - 1; i < n; j = i++)
+        a += refpoly.x[j] * refpoly.y[i] - refpoly.x[i] * refpoly.y[j];
+
+    return a;
+}
+
+/*
+ * Indices of the polygon vertices, skipping repeated consecutive points
+ * (such as a closing point equal to the first one)
+ */
+static std::vector<unsigned int> distinct_vertices(const Polygon &poly) {
+    std::vector<unsigned int> idx;
+    size_t n = poly.size();
+
+    for(size_t i = 0; i < n; i++) {
+        const Point &P = poly[i], &Q = poly[(i + 1) % n];
+        if(n == 1 || P.x != Q.x || P.y != Q.y || P.z != Q.z)
+            idx.push_back(i);
+    }
+
+    return idx;
+}
+
+/*
+ * Triangulate the end caps once, in the reference frame. Polygons which
+ * are not simple get a plain fan, so the triangle count is always known.
+ */
+static std::vector<Face> cap_triangulation(const Polygon &poly, const RefPolygon &refpoly) {
+    std::vector<unsigned int> idx = distinct_vertices(poly);
+    std::vector<double> x, y;
+    std::vector<Face> cap;
+
+    if(idx.size() < 3)
+        return cap;
+
+    for(size_t i = 0; i < idx.size(); i++) {
+        x.push_back(refpoly.x[idx[i]]);
+        y.push_back(refpoly.y[idx[i]]);
+    }
+
+    cap = triangulate_polygon(x, y);
+    if(cap.size() != idx.size() - 2) {
+        cap.clear();
+        for(unsigned int i = 1; i + 1 < idx.size(); i++)
+            cap.push_back(Face(0, i, i + 1));
+    }
+
+    for(size_t t = 0; t < cap.size(); t++)
+        for(int k = 0; k < 3; k++)
+            cap[t].indices[k] = idx[cap[t].indices[k]];
+
+    return cap;
+}
+
+/*
+ * Unit vector normal to the unit vector t, across its smallest component
+ */
+static Vector any_normal(Vector t) {
+    Vector e(1., 0., 0.);
+
+    if(std::fabs(t.y) < std::fabs(t.x) && std::fabs(t.y) <= std::fabs(t.z))
+        e = Vector(0., 1., 0.);
+    else if(std::fabs(t.z) < std::fabs(t.x) && std::fabs(t.z) < std::fabs(t.y))
+        e = Vector(0., 0., 1.);
+
+    Vector r = Vector::cross(t, e);
+    return (1. / r.norm()) * r;
+}
+
+/*
+ * Reflect v in the plane normal to u, given c = u.u
+ */
+static inline Vector reflect(Vector v, Vector u, double c) {
+    return v - (2. / c * Vector::dot(u, v)) * u;
+}
+
+/*
+ * X axes of rotation-minimizing frames along samples [begin, m) of the
+ * path, by the double reflection method (Wang, Juttler, Zheng, Liu, 2008),
+ * in one pass, carried on from the frame of sample begin - 1. The frames
+ * are further rotated around the tangent by twist radians per unit of path
+ * length. normals receives the frames before that rotation and lengths the
+ * path length at each sample; both are only needed to carry on later, and
+ * may be NULL from the first sample.
+ */
+static void propagate_axes(const SampleSource &path, double twist, size_t begin, Vector *normals, double *lengths, Vector *axes) {
+    size_t m = path.size();
+    SampleBuffer buf;
+    Point x0;
+    Vector t0, r0;
+    double length = 0.;
+
+    if(begin > 0) {
+        const PathSample *prev = path.fetch(begin - 1, begin, buf.samples);
+        x0 = prev->first;
+        t0 = prev->second;
+        t0 *= 1. / t0.norm();
+        r0 = normals[begin - 1];
+        length = lengths[begin - 1];
+    }
+
+    for(; begin < m; begin += SAMPLE_BLOCK) {
+        size_t block_end = std::min(m, begin + (size_t)SAMPLE_BLOCK);
+        const PathSample *smp = path.fetch(begin, block_end, buf.samples);
+
+        for(size_t i = begin; i < block_end; i++, smp++) {
+            Point x1 = smp->first;
+            Vector t1 = smp->second;
+            Vector r1;
+
+            t1 *= 1. / t1.norm();
+
+            if(i == 0) {
+                r1 = any_normal(t1);
+            } else {
+                // Reflect across the chord, then across the bisector of the tangents
+                Vector v1 = x1 - x0;
+                double c1 = Vector::dot(v1, v1);
+                Vector rL = c1 > 0. ? reflect(r0, v1, c1) : r0;
+                Vector tL = c1 > 0. ? reflect(t0, v1, c1) : t0;
+                Vector v2 = t1 - tL;
+                double c2 = Vector::dot(v2, v2);
+                r1 = c2 > 0. ? reflect(rL, v2, c2) : rL;
+
+                // Keep it a unit normal to the tangent despite rounding
+                r1 -= Vector::dot(r1, t1) * t1;
+                r1 *= 1. / r1.norm();
+
+                length += std::sqrt(c1);
+            }
+
+            if(twist != 0.) {
+                double a = twist * length;
+                axes[i] = std::cos(a) * r1 + std::sin(a) * Vector::cross(t1, r1);
+            } else {
+                axes[i] = r1;
+            }
+            if(normals != NULL)
+                normals[i] = r1;
+            if(lengths != NULL)
+                lengths[i] = length;
+
+            x0 = x1;
+            t0 = t1;
+            r0 = r1;
+        }
+    }
+}
+
+/*
+ * X axes of rotation-minimizing frames along the path. They are propagated
+ * along the dense path, so that a level of detail gets the same frames as
+ * the full extrusion.
+ */
+static Vector *rotation_minimizing_axes(const SampleSource &sampled, double twist, Arena &arena) {
+    const SampleSource &path = sampled.dense();
+    Vector *axes = arena.alloc<Vector>(path.size());
+
+    propagate_axes(path, twist, 0, NULL, NULL, axes);
+
+    if(&path != &sampled) {
+        Vector *picked = arena.alloc<Vector>(sampled.size());
+        for(size_t k = 0; k < sampled.size(); k++)
+            picked[k] = axes[sampled.index(k)];
+        axes = picked;
+    }
+
+    return axes;
+}
+
+/*
+ * Express the polygon in the frame of the first path sample, so that each
+ * ring is obtained by mapping it through the frame of its own sample.
+ */
+Extruder::Extruder(const Polygon &poly, const SampleSource &path, const SampleSource &guide, double twist, Arena &arena):
+    Extruder(poly, path, guide, guide.size() == 0 ? rotation_minimizing_axes(path, twist, arena) : NULL, arena) {
+}
+
+/*
+ * Same with the given X axes, which must outlive the extruder, or NULL to
+ * follow the guide
+ */
+Extruder::Extruder(const Polygon &poly, const SampleSource &path, const SampleSource &guide, const Vector *axes, Arena &arena): path(path), guide(guide), axes(axes) {
+    PathSample path_buf, guide_buf;
     Point path_fst, guide_fst;
     Vector refX, refY, refZ;
-    Matrix refP, refPI;
+    Matrix refP;
 
-    path_fst = path.front().first;
-    guide_fst = guide.front().first;
-    refZ = path.front().second;
+    const PathSample &path_smp = *path.fetch(0, 1, &path_buf);
+
+    path_fst = path_smp.first;
+    refZ = path_smp.second;
     refZ *= 1. / refZ.norm();
 
-    refX = guide_fst - path_fst;
+    if(this->axes != NULL)
+        refX = this->axes[0];
+    else {
+        guide_fst = guide.fetch(0, 1, &guide_buf)->first;
+        refX = guide_fst - path_fst;
+    }
     refY = Vector::cross(refZ, refX);
 
     //std::cout << "refX = (" << refX.dump() << "), refY = (" << refY.dump() << "), refZ = (" << refZ.dump() << ")" << std::endl;
     refP.AssignColumns(refX, refY, refZ);
-    refPI = refP.Invert();
+    this->ref_origin = path_fst;
+    this->ref_inverse = refP.Invert();
     //std::string *srefP = refP.dump();
-    //std::string *srefPI = refPI.dump();
+    //std::string *srefPI = this->ref_inverse.dump();
     //std::cout << "       ⎛" << srefP[0] << "⎞          ⎛" << srefPI[0] << "⎞" << std::endl
     //          << "refP = ⎜" << srefP[1] << "⎟, refPI = ⎜" << srefPI[1] << "⎟" << std::endl
     //          << "       ⎝" << srefP[2] << "⎠          ⎝" << srefPI[2] << "⎠" << std::endl;
     //delete[] srefP;
     //delete[] srefPI;
 
-    for(Polygon::iterator poly_it = poly.begin(); poly_it != poly.end(); poly_it++) {
-        refpoly.push_back((Point)(refPI * (*poly_it - path_fst)));
+    this->set_polygon(poly, arena);
+}
+
+/*
+ * Set the reference polygon and its caps up for poly, keeping the frames:
+ * a polygon edit only needs the rings mapped again
+ */
+void Extruder::set_polygon(const Polygon &poly, Arena &arena) {
+    RefPolygon &refpoly = this->refpoly;
+
+    refpoly.n = poly.size();
+    refpoly.x = arena.alloc<double>(refpoly.n);
+    refpoly.y = arena.alloc<double>(refpoly.n);
+    refpoly.z = arena.alloc<double>(refpoly.n);
+    refpoly.xf = arena.alloc<float>(refpoly.n);
+    refpoly.yf = arena.alloc<float>(refpoly.n);
+    refpoly.zf = arena.alloc<float>(refpoly.n);
+    for(size_t i = 0; i < refpoly.n; i++) {
+        Point R = this->ref_inverse * (poly[i] - this->ref_origin);
+        refpoly.x[i] = R.x;
+        refpoly.y[i] = R.y;
+        refpoly.z[i] = R.z;
+        refpoly.xf[i] = R.x;
+        refpoly.yf[i] = R.y;
+        refpoly.zf[i] = R.z;
+    }
+
+    this->ccw = polygon_orientation(refpoly) >= 0.;
+    this->cap = cap_triangulation(poly, refpoly);
+}
+
+/*
+ * The extruder of poly, made of the given columns of the polygon of full,
+ * along samples picked from those of full: the reference frame is the same,
+ * so the reference polygon and the axes are picked from those of full
+ * rather than computed again
+ */
+Extruder::Extruder(const Extruder &full, const Polygon &poly, const std::vector<unsigned int> &columns, const SampleSource &path, const SampleSource &guide, Arena &arena):
+    path(path), guide(guide), ref_origin(full.ref_origin), ref_inverse(full.ref_inverse) {
+    RefPolygon &refpoly = this->refpoly;
+
+    this->axes = NULL;
+    if(full.axes != NULL) {
+        Vector *axes = arena.alloc<Vector>(path.size());
+        for(size_t k = 0; k < path.size(); k++)
+            axes[k] = full.axes[path.index(k)];
+        this->axes = axes;
+    }
+
+    refpoly.n = columns.size();
+    refpoly.x = arena.alloc<double>(refpoly.n);
+    refpoly.y = arena.alloc<double>(refpoly.n);
+    refpoly.z = arena.alloc<double>(refpoly.n);
+    refpoly.xf = arena.alloc<float>(refpoly.n);
+    refpoly.yf = arena.alloc<float>(refpoly.n);
+    refpoly.zf = arena.alloc<float>(refpoly.n);
+    for(size_t i = 0; i < refpoly.n; i++) {
+        unsigned int c = columns[i];
+        refpoly.x[i] = full.refpoly.x[c];
+        refpoly.y[i] = full.refpoly.y[c];
+        refpoly.z[i] = full.refpoly.z[c];
+        refpoly.xf[i] = full.refpoly.xf[c];
+        refpoly.yf[i] = full.refpoly.yf[c];
+        refpoly.zf[i] = full.refpoly.zf[c];
+    }
+
+    this->ccw = polygon_orientation(refpoly) >= 0.;
+    this->cap = cap_triangulation(poly, refpoly);
+}
+
+/*
+ * Frame of one path sample, mapping the reference polygon to its ring
+ */
+void Extruder::frame(const PathSample &path_smp, const Vector &X, Matrix &P) const {
+    Vector Y, Z;
+
+    Z = path_smp.second;
+    Z *= 1. / Z.norm();
+
+    Y = Vector::cross(Z, X);
+
+    //std::cout << "X = (" << X.dump() << "), Y = (" << Y.dump() << "), Z = (" << Z.dump() << ")" << std::endl;
+
+    P.AssignColumns(X, Y, Z);
+}
+
+/*
+ * Compute rings [begin, end) into out, n points per ring. Frames are always
+ * computed in double precision, only the ring vertices are stored as T.
+ */
+template<class T>
+void Extruder::rings(size_t begin, size_t end, PointT<T> *out, ExtrudeStats *stats) const {
+    SampleBuffer path_buf, guide_buf;
+    const RefPolygon &refpoly = this->refpoly;
+    size_t n = refpoly.size();
+    Matrix P;
+
+    if(stats != NULL) {
+        stats->rings += end - begin;
+        stats->vertices += (end - begin) * n;
+    }
+
+    while(begin < end) {
+        size_t block_end = std::min(end, begin + SAMPLE_BLOCK);
+        double t0 = stats != NULL ? stats_clock() : 0.;
+        const PathSample *path_smp = this->path.fetch(begin, block_end, path_buf.samples);
+        const PathSample *guide_smp = NULL;
+
+        if(this->axes == NULL)
+            guide_smp = this->guide.fetch(begin, block_end, guide_buf.samples);
+
+        for(size_t i = 0; i < block_end - begin; i++, out += n) {
+            if(this->axes != NULL) {
+                this->frame(path_smp[i], this->axes[begin + i], P);
+            } else {
+                Point path_cur = path_smp[i].first, guide_cur = guide_smp[i].first;
+                this->frame(path_smp[i], guide_cur - path_cur, P);
+            }
+
+            if(stats != NULL) {
+                double t1 = stats_clock();
+                stats->frame_time += t1 - t0;
+                t0 = t1;
+            }
+
+            refpoly.transform(P, path_smp[i].first, out);
+
+            if(stats != NULL) {
+                double t1 = stats_clock();
+                stats->transform_time += t1 - t0;
+                t0 = t1;
+            }
+        }
+
+        begin = block_end;
+    }
+}
+
+/*
+ * Triangulate the strip between two consecutive rings. The triangles of
+ * the tube and of the caps are wound so that their normals point out of
+ * the solid.
+ */
+void Extruder::strip(const Point *oldp, const Point *newp, Triangle *out) const {
+    size_t n = this->refpoly.size(), prev = n - 1;
+
+    for(size_t j = 0; j < n; j++) {
+        if(this->ccw) {
+            *out++ = Triangle(oldp[prev], newp[j], newp[prev]);
+            *out++ = Triangle(oldp[prev], oldp[j], newp[j]);
+        } else {
+            *out++ = Triangle(oldp[prev], newp[prev], newp[j]);
+            *out++ = Triangle(oldp[prev], newp[j], oldp[j]);
+        }
+        prev = j;
+    }
+}
+
+/*
+ * Faces of the strip between the rings starting at vertices oldp and newp
+ */
+void Extruder::strip_faces(unsigned int oldp, unsigned int newp, Face *out) const {
+    unsigned int n = this->refpoly.size(), prev = n - 1;
+
+    for(unsigned int j = 0; j < n; j++) {
+        if(this->ccw) {
+            *out++ = Face(oldp + prev, newp + j, newp + prev);
+            *out++ = Face(oldp + prev, oldp + j, newp + j);
+        } else {
+            *out++ = Face(oldp + prev, newp + prev, newp + j);
+            *out++ = Face(oldp + prev, newp + j, oldp + j);
+        }
+        prev = j;
     }
+}
 
-    for(Path::iterator path_it = path.begin(), guide_it = guide.begin(); path_it != path.end(); path_it++, guide_it++) {
-        Polygon newp;
-        Point path_cur, guide_cur;
-        Vector X, Y, Z;
-        Matrix P;
-        Point oldp_prev, newp_prev;
+template<class T>
+static inline bool same_point(const PointT<T> &a, const PointT<T> &b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
 
-        path_cur = (*path_it).first;
-        guide_cur = (*guide_it).first;
-        Z = (*path_it).second;
-        Z *= 1. / Z.norm();
+/*
+ * Strip between two rings kept by the simplification, where the vertices
+ * of newp coinciding with those of oldp were welded to them: the triangles
+ * collapsed by a welded vertex are dropped. Returns the triangle count.
+ */
+size_t Extruder::welded_strip(const Point *oldp, const Point *newp, Triangle *out) const {
+    size_t n = this->refpoly.size(), prev = n - 1;
+    Triangle *first = out;
 
-        X = guide_cur - path_cur;
-        Y = Vector::cross(Z, X);
+    for(size_t j = 0; j < n; j++) {
+        bool keep_prev = !same_point(oldp[prev], newp[prev]), keep_j = !same_point(oldp[j], newp[j]);
+        if(this->ccw) {
+            if(keep_prev)
+                *out++ = Triangle(oldp[prev], newp[j], newp[prev]);
+            if(keep_j)
+                *out++ = Triangle(oldp[prev], oldp[j], newp[j]);
+        } else {
+            if(keep_prev)
+                *out++ = Triangle(oldp[prev], newp[prev], newp[j]);
+            if(keep_j)
+                *out++ = Triangle(oldp[prev], newp[j], oldp[j]);
+        }
+        prev = j;
+    }
 
-        //std::cout << "X = (" << X.dump() << "), Y = (" << Y.dump() << "), Z = (" << Z.dump() << ")" << std::endl;
+    return out - first;
+}
 
-        P.AssignColumns(X, Y, Z);
+/*
+ * Same with vertex indices per column, a welded vertex keeping its index
+ */
+size_t Extruder::welded_strip_faces(const unsigned int *oldp, const unsigned int *newp, Face *out) const {
+    unsigned int n = this->refpoly.size(), prev = n - 1;
+    Face *first = out;
 
-        for(Polygon::iterator refpoly_it = refpoly.begin(); refpoly_it != refpoly.end(); refpoly_it++) {
-            Point PP = path_cur + P * (*refpoly_it);
-            //std::cout << "(" << (*refpoly_it).dump() << ") -> (" << PP.dump() << ")" << std::endl;
-            newp.push_back(PP);
+    for(unsigned int j = 0; j < n; j++) {
+        bool keep_prev = oldp[prev] != newp[prev], keep_j = oldp[j] != newp[j];
+        if(this->ccw) {
+            if(keep_prev)
+                *out++ = Face(oldp[prev], newp[j], newp[prev]);
+            if(keep_j)
+                *out++ = Face(oldp[prev], oldp[j], newp[j]);
+        } else {
+            if(keep_prev)
+                *out++ = Face(oldp[prev], newp[prev], newp[j]);
+            if(keep_j)
+                *out++ = Face(oldp[prev], newp[j], oldp[j]);
         }
-        
-        oldp_prev = oldp.back();
-        newp_prev = newp.back();
-        for(Polygon::iterator oldp_it = oldp.begin(), newp_it = newp.begin(); oldp_it != oldp.end() && newp_it != newp.end(); oldp_it++, newp_it++) {
-            Triangle T1(oldp_prev, newp_prev, *newp_it);
-            Triangle T2(oldp_prev, *oldp_it, *newp_it);
+        prev = j;
+    }
+
+    return out - first;
+}
+
+/*
+ * The start cap faces backwards along the path, the end cap forwards
+ */
+void Extruder::cap_triangles(const Point *ring, bool end, Triangle *out) const {
+    bool flip = (end != this->ccw);
+
+    for(size_t t = 0; t < this->cap.size(); t++) {
+        const unsigned int *v = this->cap[t].indices;
+        if(flip)
+            *out++ = Triangle(ring[v[0]], ring[v[2]], ring[v[1]]);
+        else
+            *out++ = Triangle(ring[v[0]], ring[v[1]], ring[v[2]]);
+    }
+}
+
+void Extruder::cap_faces(unsigned int ring, bool end, Face *out) const {
+    bool flip = (end != this->ccw);
+
+    for(size_t t = 0; t < this->cap.size(); t++) {
+        const unsigned int *v = this->cap[t].indices;
+        if(flip)
+            *out++ = Face(ring + v[0], ring + v[2], ring + v[1]);
+        else
+            *out++ = Face(ring + v[0], ring + v[1], ring + v[2]);
+    }
+}
+
+// Same with the vertex index of each column of the ring
+void Extruder::welded_cap_faces(const unsigned int *ring, bool end, Face *out) const {
+    bool flip = (end != this->ccw);
+
+    for(size_t t = 0; t < this->cap.size(); t++) {
+        const unsigned int *v = this->cap[t].indices;
+        if(flip)
+            *out++ = Face(ring[v[0]], ring[v[2]], ring[v[1]]);
+        else
+            *out++ = Face(ring[v[0]], ring[v[1]], ring[v[2]]);
+    }
+}
+
+static int thread_count(const ExtrudeOptions &opts) {
+    if(opts.threads > 0)
+        return opts.threads;
+
+    int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+/*
+ * Split [begin, end) into one contiguous chunk per thread and call
+ * f(thread, chunk_begin, chunk_end) for each of them concurrently
+ */
+template<class F>
+static void parallel_chunks(size_t begin, size_t end, int nthreads, F f) {
+    size_t count = end - begin;
+
+    if(nthreads > (int)count)
+        nthreads = count;
+    if(nthreads <= 1) {
+        f(0, begin, end);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    for(int t = 0; t < nthreads; t++)
+        workers.push_back(std::thread(f, t, begin + count * t / nthreads, begin + count * (t + 1) / nthreads));
+    for(size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+}
+
+ExtrudeOptions::ExtrudeOptions() {
+    this->threads = 1;
+    this->stats = NULL;
+    this->arena = NULL;
+    this->twist = 0.;
+    this->simplify = false;
+    this->lod = 0;
+}
 
-            obj.push_back(T1);
-            obj.push_back(T2);
+ExtrudeStats::ExtrudeStats() {
+    this->clear();
+}
+
+void ExtrudeStats::clear() {
+    this->setup_time = this->frame_time = this->transform_time = 0.;
+    this->strip_time = this->output_time = this->total_time = 0.;
+    this->rings = this->vertices = this->triangles = 0;
+    this->allocations = this->bytes = 0;
+}
+
+void ExtrudeStats::add(const ExtrudeStats &S) {
+    this->setup_time += S.setup_time;
+    this->frame_time += S.frame_time;
+    this->transform_time += S.transform_time;
+    this->strip_time += S.strip_time;
+    this->output_time += S.output_time;
+    this->total_time += S.total_time;
+    this->rings += S.rings;
+    this->vertices += S.vertices;
+    this->triangles += S.triangles;
+    this->allocations += S.allocations;
+    this->bytes += S.bytes;
+}
+
+void ExtrudeStats::WriteJSON(FILE *fd) {
+    fprintf(fd, "{\"setup_time\": %g, \"frame_time\": %g, \"transform_time\": %g, "
+                "\"strip_time\": %g, \"output_time\": %g, \"total_time\": %g, "
+                "\"rings\": %zu, \"vertices\": %zu, \"triangles\": %zu, "
+                "\"allocations\": %zu, \"bytes\": %zu}\n",
+            this->setup_time, this->frame_time, this->transform_time,
+            this->strip_time, this->output_time, this->total_time,
+            this->rings, this->vertices, this->triangles,
+            this->allocations, this->bytes);
+}
+
+/*
+ * Per-thread statistics, merged into the caller's record when done
+ */
+class LocalStats {
+public:
+    ExtrudeStats *target;
+    ExtrudeStats local;
+
+    LocalStats(ExtrudeStats *target): target(target) {}
+
+    ExtrudeStats *get() {
+        return this->target != NULL ? &this->local : NULL;
+    }
 
-            oldp_prev = *oldp_it;
-            newp_prev = *newp_it;
+    void merge(std::mutex &lock) {
+        if(this->target != NULL) {
+            std::lock_guard<std::mutex> guard(lock);
+            this->target->add(this->local);
         }
+    }
+};
+
+static size_t extrude_count(size_t n, size_t ncap, size_t m, bool close_ends) {
+    if(n == 0 || m == 0)
+        return 0;
+    return 2 * n * (m - 1) + (close_ends ? 2 * ncap : 0);
+}
 
-        oldp = newp;
+static size_t cap_count(const Polygon &poly) {
+    size_t k = distinct_vertices(poly).size();
+    return k >= 3 ? k - 2 : 0;
+}
+
+// Vertices of each ring of the full extrusion
+static size_t ring_size(const Polygon &poly, bool close_ends) {
+    return close_ends ? distinct_vertices(poly).size() : poly.size();
+}
+
+// Whether the polygon is extruded as given, repeated points included
+static bool whole_polygon(bool close_ends, const ExtrudeOptions &opts) {
+    return !close_ends && !opts.simplify && opts.lod <= 0;
+}
+
+/*
+ * Indices of the polygon vertices extruded: all of them by default, else
+ * those without repeated consecutive points, whose strips would only hold
+ * zero-area triangles, and of those every 2^lod-th, keeping at least three.
+ * The caps are built on the distinct points, so closing the ends drops the
+ * repeated ones too: the strips then share their edges with the caps.
+ */
+static std::vector<unsigned int> level_vertices(const Polygon &poly, bool close_ends, const ExtrudeOptions &opts) {
+    std::vector<unsigned int> idx;
+
+    if(whole_polygon(close_ends, opts)) {
+        idx.resize(poly.size());
+        std::iota(idx.begin(), idx.end(), 0);
+        return idx;
     }
 
-    return obj;
+    idx = distinct_vertices(poly);
+    size_t k = idx.size(), stride = (size_t)1 << std::max(opts.lod, 0);
+    stride = std::max((size_t)1, std::min(stride, k / 3));
+
+    std::vector<unsigned int> res;
+    for(size_t i = 0; i < k; i += stride)
+        res.push_back(idx[i]);
+
+    return res;
+}
+
+// Nothing is extruded without samples, or when no polygon vertex is left
+static bool empty_extrusion(const Polygon &poly, size_t m, bool close_ends, const ExtrudeOptions &opts) {
+    return m == 0 || poly.empty() || (!whole_polygon(close_ends, opts) && distinct_vertices(poly).empty());
+}
+
+// Rings of n vertices held by a block of the given number of vertices, at least one
+static size_t block_rings(size_t vertices, size_t n) {
+    return n > 0 ? std::max((size_t)1, vertices / n) : 1;
 }
 
+// The polygon extruded, in storage unless it is poly itself
+static const Polygon &level_polygon(const Polygon &poly, bool close_ends, const ExtrudeOptions &opts, Polygon &storage) {
+    if(whole_polygon(close_ends, opts))
+        return poly;
+
+    std::vector<unsigned int> idx = level_vertices(poly, close_ends, opts);
+    storage.clear();
+    for(size_t i = 0; i < idx.size(); i++)
+        storage.push_back(poly[idx[i]]);
+
+    return storage;
+}
+
+/*
+ * Tolerance of the simplification tests, relative to the coordinates: a
+ * few units in the last place of the vertex type, so that only rounding
+ * differences are merged away
+ */
+template<class T>
+static double simplify_tolerance() {
+    return 8. * std::numeric_limits<T>::epsilon();
+}
+
+// M lies on the segment [A, B], within distance eps
+static bool on_segment(Vector A, Vector M, Vector B, double eps) {
+    Vector a = M - A, b = B - A;
+    double lb = b.norm();
+
+    if(lb <= eps)
+        return a.norm() <= eps;
+
+    double d = Vector::dot(a, b) / lb;
+    return Vector::cross(a, b).norm() <= eps * lb && d >= -eps && d <= lb + eps;
+}
+
+// The quad (A, B, C, D) is flat; it always is when A, B and C are aligned
+static bool coplanar(Vector A, Vector B, Vector C, Vector D, double eps) {
+    Vector N = Vector::cross(B - A, C - A);
+    double ln = N.norm();
+
+    if(ln <= eps * ((B - A).norm() + (C - A).norm()))
+        return true;
+    return std::fabs(Vector::dot(N, D - A)) <= eps * ln;
+}
+
+/*
+ * Whether the ring mid between the rings kept and next can be dropped
+ * without changing the surface: each of its vertices lies on the segment
+ * joining the corresponding ones of kept and next, and the merged quads
+ * are flat.
+ */
+template<class T>
+static bool ring_removable(const PointT<T> *kept, const PointT<T> *mid, const PointT<T> *next, size_t n) {
+    double tol = simplify_tolerance<T>();
+
+    for(size_t j = 0, prev = n - 1; j < n; prev = j++) {
+        Vector K(kept[j]), M(mid[j]), N(next[j]), KP(kept[prev]), NP(next[prev]);
+        double eps = tol * std::max(std::max(K.norm(), N.norm()), std::max(KP.norm(), NP.norm()));
+
+        if(!on_segment(K, M, N, eps) || !coplanar(KP, K, N, NP, eps))
+            return false;
+    }
+
+    return true;
+}
+
+// Move the vertices of ring within rounding distance of those of prev onto them
+template<class T>
+static void weld_ring(const PointT<T> *prev, PointT<T> *ring, size_t n) {
+    double tol = simplify_tolerance<T>();
+
+    // Squared distances, the test running on every vertex kept
+    for(size_t j = 0; j < n; j++) {
+        Vector P(prev[j]), R(ring[j]), D = R - P;
+        if(Vector::dot(D, D) <= tol * tol * std::max(Vector::dot(P, P), Vector::dot(R, R)))
+            ring[j] = prev[j];
+    }
+}
+
+/*
+ * Simplification, run as the rings are produced by rings(begin, end, out)
+ * in blocks of up to block rings. The last ring kept, a pending one and the
+ * current one are alive at any time: the pending ring is dropped when it
+ * lies on the strip between its neighbours. Each ring kept gets the
+ * vertices it shares with the previous one welded, then is handed to
+ * join(previous, ring), previous being NULL for the first ring. buf holds
+ * (block + 2) * n vertices.
+ */
+template<class T, class R, class F>
+static void simplify_rings(size_t n, size_t m, size_t block, PointT<T> *buf, R rings, F join) {
+    PointT<T> *kept = buf, *pending = buf + n, *window = buf + 2 * n;
+    const PointT<T> *cur = NULL;
+    size_t window_begin = 2, window_end = 2;
+
+    rings(0, 1, kept);
+    join((const PointT<T> *)NULL, (const PointT<T> *)kept);
+    if(m > 1)
+        rings(1, 2, pending);
+
+    for(size_t i = 2; i <= m; i++) {
+        bool last = i == m;
+        if(!last) {
+            if(i == window_end) {
+                window_begin = i;
+                window_end = std::min(m, i + block);
+                rings(window_begin, window_end, window);
+            }
+            cur = window + (i - window_begin) * n;
+            if(ring_removable(kept, pending, cur, n)) {
+                std::copy(cur, cur + n, pending);
+                continue;
+            }
+        }
+
+        weld_ring(kept, pending, n);
+        join((const PointT<T> *)kept, (const PointT<T> *)pending);
+
+        std::swap(kept, pending);
+        if(!last)
+            std::copy(cur, cur + n, pending);
+    }
+}
+
+/*
+ * Extrusion into a mesh, as independent ranges of rings: faces only refer
+ * to vertex indices, so each range computes its own rings and the strips
+ * ending on them. Faces are laid out as: start cap, strips in path order,
+ * end cap.
+ */
+template<class T>
+class MeshExtrusion {
+public:
+    Extruder ext;
+    MeshT<T> &mesh;
+    bool close_ends;
+    unsigned int n, m, ncap;
+
+    MeshExtrusion(const Polygon &poly, const SampleSource &path, const SampleSource &guide, bool close_ends, const ExtrudeOptions &opts, Arena &arena, MeshT<T> &mesh);
+    MeshExtrusion(const Extruder &ext, bool close_ends, const ExtrudeOptions &opts, MeshT<T> &mesh);
+
+    void allocate();
+    void fill(size_t begin, size_t end, ExtrudeStats *stats);
+    void strips(size_t begin, size_t end, ExtrudeStats *stats);
+    template<class R>
+    void simplified(R rings, Arena &arena, ExtrudeStats *stats);
+
+private:
+    void faces(unsigned int rings);
+};
+
+/*
+ * With simplification, the polygon passed in must already be free of
+ * repeated points
+ */
+template<class T>
+MeshExtrusion<T>::MeshExtrusion(const Polygon &poly, const SampleSource &path, const SampleSource &guide, bool close_ends, const ExtrudeOptions &opts, Arena &arena, MeshT<T> &mesh):
+    ext(poly, path, guide, opts.twist, arena), mesh(mesh), close_ends(close_ends) {
+    this->n = this->ext.refpoly.size();
+    this->m = path.size();
+    this->ncap = close_ends ? this->ext.cap.size() : 0;
+}
+
+template<class T>
+MeshExtrusion<T>::MeshExtrusion(const Extruder &ext, bool close_ends, const ExtrudeOptions &opts, MeshT<T> &mesh):
+    ext(ext), mesh(mesh), close_ends(close_ends) {
+    this->n = this->ext.refpoly.size();
+    this->m = this->ext.path.size();
+    this->ncap = close_ends ? this->ext.cap.size() : 0;
+}
+
+/*
+ * Size the mesh for all the rings, ring i occupying vertices [i*n, (i+1)*n)
+ * in polygon order
+ */
+template<class T>
+void MeshExtrusion<T>::allocate() {
+    this->mesh.vertices.resize(this->m * this->n);
+    this->faces(this->m);
+}
+
+// Size the faces for the given number of rings and fill in the caps
+template<class T>
+void MeshExtrusion<T>::faces(unsigned int rings) {
+    unsigned int n = this->n;
+
+    this->mesh.faces.resize(extrude_count(n, this->ext.cap.size(), rings, this->close_ends));
+
+    if(this->close_ends && this->ncap > 0) {
+        this->ext.cap_faces(0, false, &this->mesh.faces[0]);
+        this->ext.cap_faces((rings - 1) * n, true, &this->mesh.faces[this->mesh.faces.size() - this->ncap]);
+    }
+}
+
+template<class T>
+void MeshExtrusion<T>::fill(size_t begin, size_t end, ExtrudeStats *stats) {
+    unsigned int n = this->n;
+
+    this->ext.rings(begin, end, &this->mesh.vertices[begin * n], stats);
+    this->strips(begin, end, stats);
+}
+
+// Faces of the strips ending at rings [begin, end), once those are filled
+template<class T>
+void MeshExtrusion<T>::strips(size_t begin, size_t end, ExtrudeStats *stats) {
+    unsigned int n = this->n;
+
+    double t0 = stats != NULL ? stats_clock() : 0.;
+    for(size_t i = std::max(begin, (size_t)1); i < end; i++)
+        this->ext.strip_faces((i - 1) * n, i * n, &this->mesh.faces[this->ncap + 2 * n * (i - 1)]);
+    if(stats != NULL)
+        stats->strip_time += stats_clock() - t0;
+}
+
+/*
+ * Simplified extrusion, sequential, with the rings given by
+ * rings(begin, end, out): only the rings kept are stored, and of those only
+ * the vertices not welded to the previous ring. cols holds the vertex index
+ * of each column of the last ring kept.
+ */
+template<class T>
+template<class R>
+void MeshExtrusion<T>::simplified(R rings, Arena &arena, ExtrudeStats *stats) {
+    unsigned int n = this->n;
+
+    if(n == 0) {
+        this->mesh.vertices.clear();
+        this->mesh.faces.clear();
+        return;
+    }
+
+    size_t block = block_rings(SINK_BLOCK, n);
+    PointT<T> *buf = arena.alloc<PointT<T> >(n * (block + 2));
+    unsigned int *cols = arena.alloc<unsigned int>(n), *prev_cols = arena.alloc<unsigned int>(n);
+    Face *strip = arena.alloc<Face>(2 * n);
+    std::vector<PointT<T> > &vertices = this->mesh.vertices;
+    std::vector<Face> &faces = this->mesh.faces;
+
+    // Room for every ring: only the pages written by the rings kept are touched
+    vertices.clear();
+    vertices.reserve((size_t)this->m * n);
+    faces.reserve(extrude_count(n, this->ext.cap.size(), this->m, this->close_ends));
+    faces.resize(this->ncap);
+    if(this->ncap > 0)
+        this->ext.cap_faces(0, false, &faces[0]);
+
+    simplify_rings<T>(n, this->m, block, buf, rings, [&](const PointT<T> *prev, const PointT<T> *ring) {
+        double t0 = stats != NULL ? stats_clock() : 0.;
+
+        std::swap(cols, prev_cols);
+        for(unsigned int j = 0; j < n; j++) {
+            if(prev != NULL && same_point(prev[j], ring[j])) {
+                cols[j] = prev_cols[j];
+            } else {
+                cols[j] = vertices.size();
+                vertices.push_back(ring[j]);
+            }
+        }
+
+        if(prev != NULL) {
+            size_t k = this->ext.welded_strip_faces(prev_cols, cols, strip);
+            faces.insert(faces.end(), strip, strip + k);
+        }
+
+        if(stats != NULL)
+            stats->strip_time += stats_clock() - t0;
+    });
+
+    if(this->ncap > 0) {
+        size_t f = faces.size();
+        faces.resize(f + this->ncap);
+        this->ext.welded_cap_faces(cols, true, &faces[f]);
+    }
+}
+
+template<class T>
+static MeshT<T> extrude_mesh(const Polygon &poly, const SampleSource &full_path, const SampleSource &full_guide, bool close_ends, const ExtrudeOptions &opts) {
+    StridedSource path(full_path, opts.lod), guide(full_guide, opts.lod);
+    MeshT<T> mesh;
+
+    if(empty_extrusion(poly, path.size(), close_ends, opts))
+        return mesh;
+
+    ExtrudeStats *stats = STATS(opts);
+    std::mutex stats_lock;
+    double start = stats != NULL ? stats_clock() : 0., t0 = 0.;
+
+    Arena local_arena;
+    Arena &arena = opts.arena != NULL ? *opts.arena : local_arena;
+    size_t arena_blocks = arena.blocks(), arena_capacity = arena.capacity();
+
+    Polygon storage;
+    MeshExtrusion<T> job(level_polygon(poly, close_ends, opts, storage), path, guide, close_ends, opts, arena, mesh);
+    int nthreads = thread_count(opts);
+
+    if(stats != NULL) {
+        t0 = stats_clock();
+        stats->setup_time += t0 - start;
+        stats_alloc(stats, job.ext.cap);
+    }
+
+    if(opts.simplify) {
+        // Dropping rings needs the next one, so simplification runs sequentially
+        job.simplified([&](size_t begin, size_t end, PointT<T> *out) {
+            job.ext.rings(begin, end, out, stats);
+        }, arena, stats);
+    } else {
+        job.allocate();
+
+        if(stats != NULL)
+            stats->output_time += stats_clock() - t0;
+
+        parallel_chunks(0, job.m, nthreads, [&](int, size_t begin, size_t end) {
+            LocalStats local(stats);
+            job.fill(begin, end, local.get());
+            local.merge(stats_lock);
+        });
+    }
+
+    if(stats != NULL) {
+        stats_arena(stats, arena, arena_blocks, arena_capacity);
+        stats_alloc(stats, mesh.vertices);
+        stats_alloc(stats, mesh.faces);
+        stats->triangles += mesh.faces.size();
+        stats->total_time += stats_clock() - start;
+    }
+
+    return mesh;
+}
+
+/*
+ * State of one job of a batch, alive until the whole batch is done
+ */
+class BatchJob {
+public:
+    StoredSource full_path, full_guide;
+    StridedSource path, guide;
+    Polygon storage;
+    Arena arena;
+    std::unique_ptr<MeshExtrusion<double> > extrusion;
+    std::atomic<size_t> ranges;     // ranges of rings still to fill
+
+    BatchJob(const ExtrudeJob &job, int lod):
+        full_path(job.path), full_guide(job.guide), path(full_path, lod), guide(full_guide, lod), ranges(0) {}
+};
+
+/*
+ * Each job starts as a single task which sets the extrusion up, then
+ * spawns its ranges of rings on the same worker, where idle workers can
+ * steal them. Simplified jobs run as a single task instead.
+ */
+static std::vector<Mesh> extrude_batch(const std::vector<ExtrudeJob> &jobs, const ExtrudeOptions &opts) {
+    std::vector<Mesh> meshes(jobs.size());
+    std::vector<std::unique_ptr<BatchJob> > state(jobs.size());
+    ExtrudeStats *stats = STATS(opts);
+    double start = stats != NULL ? stats_clock() : 0.;
+
+    TaskPool pool(thread_count(opts));
+    std::vector<ExtrudeStats> worker_stats(pool.size());
+
+    // Largest jobs first, dealt round robin, so that they start early
+    std::vector<size_t> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return jobs[a].poly.size() * jobs[a].path.size() > jobs[b].poly.size() * jobs[b].path.size();
+    });
+
+    for(size_t k = 0; k < order.size(); k++) {
+        size_t j = order[k];
+
+        pool.spawn(k % pool.size(), [&, j](int worker) {
+            const ExtrudeJob &job = jobs[j];
+            ExtrudeStats *st = stats != NULL ? &worker_stats[worker] : NULL;
+            double t0 = st != NULL ? stats_clock() : 0.;
+
+            if(empty_extrusion(job.poly, job.path.size(), job.close_ends, opts))
+                return;
+
+            state[j].reset(new BatchJob(job, opts.lod));
+            BatchJob &b = *state[j];
+            b.extrusion.reset(new MeshExtrusion<double>(level_polygon(job.poly, job.close_ends, opts, b.storage), b.path, b.guide, job.close_ends, opts, b.arena, meshes[j]));
+            MeshExtrusion<double> *e = b.extrusion.get();
+
+            if(st != NULL) {
+                double t1 = stats_clock();
+                st->setup_time += t1 - t0;
+                stats_alloc(st, e->ext.cap);
+                t0 = t1;
+            }
+
+            // Simplification runs sequentially, as a single task
+            if(opts.simplify) {
+                e->simplified([&](size_t begin, size_t end, Point *out) {
+                    e->ext.rings(begin, end, out, st);
+                }, b.arena, st);
+
+                if(st != NULL) {
+                    stats_arena(st, b.arena, 0, 0);
+                    stats_alloc(st, meshes[j].vertices);
+                    stats_alloc(st, meshes[j].faces);
+                    st->triangles += meshes[j].faces.size();
+                }
+                return;
+            }
+
+            e->allocate();
+
+            if(st != NULL) {
+                stats_arena(st, b.arena, 0, 0);
+                stats_alloc(st, meshes[j].vertices);
+                st->output_time += stats_clock() - t0;
+            }
+
+            size_t step = block_rings(BATCH_GRAIN, e->n);
+            b.ranges = (e->m + step - 1) / step;
+            for(size_t begin = 0; begin < e->m; begin += step) {
+                size_t end = std::min((size_t)e->m, begin + step);
+                pool.spawn(worker, [&, j, begin, end](int w) {
+                    BatchJob &b = *state[j];
+                    ExtrudeStats *st = stats != NULL ? &worker_stats[w] : NULL;
+
+                    b.extrusion->fill(begin, end, st);
+                    if(--b.ranges == 0 && st != NULL) {
+                        stats_alloc(st, meshes[j].faces);
+                        st->triangles += meshes[j].faces.size();
+                    }
+                });
+            }
+        });
+    }
+
+    pool.run();
+
+    if(stats != NULL) {
+        for(size_t w = 0; w < worker_stats.size(); w++)
+            stats->add(worker_stats[w]);
+        stats->total_time += stats_clock() - start;
+    }
+
+    return meshes;
+}
+
+/*
+ * Inputs of a progressive extrusion and its rings at full resolution, ring
+ * i of the path at [i*n, (i+1)*n) once computed
+ */
+class ProgressiveExtrusion::State {
+public:
+    Polygon poly;
+    Path path, guide;
+    bool close_ends;
+    ExtrudeOptions opts;
+    StoredSource path_source, guide_source;
+    Arena arena;
+    Extruder ext;
+    std::vector<Point> rings;
+    std::vector<char> computed;
+
+    State(Polygon &&poly, Path &&path, Path &&guide, bool close_ends, const ExtrudeOptions &opts):
+        poly(std::move(poly)), path(std::move(path)), guide(std::move(guide)), close_ends(close_ends), opts(opts),
+        path_source(this->path), guide_source(this->guide),
+        ext(this->poly, this->path_source, this->guide_source, opts.twist, this->arena),
+        rings(this->path.size() * this->poly.size()), computed(this->path.size(), 0) {}
+};
+
+// Nothing is set up for an empty extrusion, whose levels are all empty
+ProgressiveExtrusion::ProgressiveExtrusion(Polygon poly, Path path, Path guide, bool close_ends, const ExtrudeOptions &opts) {
+    if(!path.empty() && !poly.empty())
+        this->state.reset(new State(std::move(poly), std::move(path), std::move(guide), close_ends, opts));
+}
+
+ProgressiveExtrusion::~ProgressiveExtrusion() {
+}
+
+int ProgressiveExtrusion::levels() const {
+    if(!this->state)
+        return 1;
+
+    size_t m = this->state->path.size(), k = distinct_vertices(this->state->poly).size();
+    int level = 0;
+
+    // Stop when neither the path nor the polygon can be halved any more
+    while((((m - 1) >> (level + 1)) >= 2 || (k >> (level + 1)) >= 3))
+        level++;
+
+    return level + 1;
+}
+
+/*
+ * Set up the extrusion of the level from the full resolution one, then
+ * take its ring vertices from the full resolution rings, computing the
+ * missing ones first
+ */
+Mesh ProgressiveExtrusion::mesh(int level) {
+    Mesh mesh;
+
+    if(!this->state)
+        return mesh;
+
+    State &S = *this->state;
+
+    ExtrudeOptions opts = S.opts;
+    opts.lod = level;
+
+    ExtrudeStats *stats = STATS(opts);
+    std::mutex stats_lock;
+    double start = stats != NULL ? stats_clock() : 0.;
+
+    std::vector<unsigned int> columns = level_vertices(S.poly, S.close_ends, opts);
+    if(columns.empty())
+        return mesh;
+
+    Polygon poly;
+    for(size_t c = 0; c < columns.size(); c++)
+        poly.push_back(S.poly[columns[c]]);
+
+    Arena arena;
+    StridedSource path(S.path_source, level), guide(S.guide_source, level);
+    MeshExtrusion<double> job(Extruder(S.ext, poly, columns, path, guide, arena), S.close_ends, opts, mesh);
+    size_t n = job.n, N = S.poly.size();
+
+    if(stats != NULL)
+        stats->setup_time += stats_clock() - start;
+
+    std::vector<size_t> missing;
+    for(size_t k = 0; k < job.m; k++) {
+        size_t i = path.index(k);
+        if(!S.computed[i]) {
+            S.computed[i] = 1;
+            missing.push_back(i);
+        }
+    }
+
+    parallel_chunks(0, missing.size(), thread_count(opts), [&](int, size_t begin, size_t end) {
+        LocalStats local(stats);
+        for(size_t r = begin; r < end; r++)
+            S.ext.rings(missing[r], missing[r] + 1, &S.rings[missing[r] * N], local.get());
+        local.merge(stats_lock);
+    });
+
+    // Rings [begin, end) of the level, picked from the full resolution ones
+    auto level_rings = [&](size_t begin, size_t end, Point *out) {
+        for(size_t k = begin; k < end; k++, out += n) {
+            const Point *ring = &S.rings[path.index(k) * N];
+            for(size_t c = 0; c < n; c++)
+                out[c] = ring[columns[c]];
+        }
+    };
+
+    if(opts.simplify) {
+        job.simplified(level_rings, arena, stats);
+    } else {
+        job.allocate();
+        level_rings(0, job.m, &mesh.vertices[0]);
+        job.strips(0, job.m, stats);
+    }
+
+    if(stats != NULL) {
+        stats_alloc(stats, mesh.vertices);
+        stats_alloc(stats, mesh.faces);
+        stats->triangles += mesh.faces.size();
+        stats->total_time += stats_clock() - start;
+    }
+
+    return mesh;
+}
+
+/*
+ * Inputs of the last update and the extrusion holding its mesh. The
+ * sources refer to the stored paths, which updates patch in place.
+ */
+class IncrementalExtrusion::State {
+public:
+    ExtrudeOptions opts;
+    Polygon poly;
+    Path path, guide;
+    bool close_ends;
+    StoredSource path_source, guide_source;
+    // Without a guide, the frames and what carrying them on needs
+    std::vector<Vector> normals, axes;
+    std::vector<double> lengths;
+    // Holds the reference polygon of ext, set up again on polygon edits
+    Arena arena;
+    std::unique_ptr<Extruder> ext;
+    Mesh mesh;
+
+    State(const ExtrudeOptions &opts):
+        opts(opts), close_ends(false), path_source(this->path), guide_source(this->guide) {}
+};
+
+// Bitwise comparison, so that unchanged samples give unchanged rings
+static inline bool same_sample(const PathSample &a, const PathSample &b) {
+    return std::memcmp(&a, &b, sizeof(PathSample)) == 0;
+}
+
+static bool same_polygon(const Polygon &a, const Polygon &b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(&a[0], &b[0], a.size() * sizeof(Point)) == 0);
+}
+
+IncrementalExtrusion::IncrementalExtrusion(const ExtrudeOptions &opts): state(new State(opts)) {
+}
+
+IncrementalExtrusion::~IncrementalExtrusion() {
+}
+
+const Mesh &IncrementalExtrusion::mesh() const {
+    return this->state->mesh;
+}
+
+const Mesh &IncrementalExtrusion::update(const Polygon &poly, const Path &path, const Path &guide, bool close_ends) {
+    return this->update(poly, path, guide, close_ends, 0, path.size());
+}
+
+/*
+ * Find the rings to recompute and copy their samples in, carry the frames
+ * on from the first sample changed, map the polygon again if it changed,
+ * then patch the mesh. Only the first sample, which fixes the reference
+ * frame, or a guide added or removed, sets everything up again.
+ */
+const Mesh &IncrementalExtrusion::update(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, size_t begin, size_t end) {
+    State &S = *this->state;
+    const ExtrudeOptions &opts = S.opts;
+
+    if(opts.simplify || opts.lod > 0 || empty_extrusion(poly, path.size(), close_ends, opts)) {
+        S.ext.reset();
+        S.mesh = path_extrude_mesh(poly, path, guide, close_ends, opts);
+        return S.mesh;
+    }
+
+    ExtrudeStats *stats = STATS(opts);
+    std::mutex stats_lock;
+    double start = stats != NULL ? stats_clock() : 0.;
+
+    size_t m = path.size(), old_m = S.path.size();
+    bool rebuild = !S.ext || guide.empty() != S.guide.empty() || !same_sample(path[0], S.path[0])
+                || (!guide.empty() && !same_sample(guide[0], S.guide[0]));
+    bool reshape = rebuild || close_ends != S.close_ends || !same_polygon(poly, S.poly);
+    size_t common = rebuild ? 0 : std::min(old_m, m), first = common;
+    std::vector<size_t> changed;
+
+    // Samples past the range are the same as in the last update, except those added
+    for(size_t i = std::max(begin, (size_t)1); i < std::min(end, common); i++) {
+        if(same_sample(path[i], S.path[i]) && (guide.empty() || same_sample(guide[i], S.guide[i])))
+            continue;
+
+        // Without a guide, a change moves every frame after it
+        if(guide.empty()) {
+            first = i;
+            break;
+        }
+        changed.push_back(i);
+    }
+    for(size_t i = first; i < m; i++)
+        changed.push_back(i);
+
+    S.path.resize(m);
+    S.guide.resize(guide.size());
+    for(size_t k = 0; k < changed.size(); k++) {
+        S.path[changed[k]] = path[changed[k]];
+        if(!guide.empty())
+            S.guide[changed[k]] = guide[changed[k]];
+    }
+
+    if(guide.empty()) {
+        S.normals.resize(m);
+        S.axes.resize(m);
+        S.lengths.resize(m);
+        if(first < m)
+            propagate_axes(S.path_source, opts.twist, first, &S.normals[0], &S.lengths[0], &S.axes[0]);
+    }
+
+    size_t arena_blocks = S.arena.blocks(), arena_capacity = S.arena.capacity();
+    if(reshape) {
+        Polygon storage;
+        const Polygon &level = level_polygon(poly, close_ends, opts, storage);
+
+        S.poly = poly;
+        S.close_ends = close_ends;
+        S.arena.reset();
+        if(rebuild)
+            S.ext.reset(new Extruder(level, S.path_source, S.guide_source, guide.empty() ? &S.axes[0] : NULL, S.arena));
+        else
+            S.ext->set_polygon(level, S.arena);
+    }
+    S.ext->axes = guide.empty() ? &S.axes[0] : NULL;
+
+    MeshExtrusion<double> job(*S.ext, close_ends, opts, S.mesh);
+
+    if(stats != NULL) {
+        stats->setup_time += stats_clock() - start;
+        stats_arena(stats, S.arena, arena_blocks, arena_capacity);
+    }
+
+    // Existing strips refer to the same vertices; only new ones are written
+    job.allocate();
+    job.strips(reshape ? 0 : common, m, stats);
+
+    // A new polygon maps every ring again, through the same frames
+    if(reshape) {
+        changed.resize(m);
+        std::iota(changed.begin(), changed.end(), 0);
+    }
+
+    parallel_chunks(0, changed.size(), thread_count(opts), [&](int, size_t begin, size_t end) {
+        LocalStats local(stats);
+        while(begin < end) {
+            size_t run = begin + 1;
+            while(run < end && changed[run] == changed[run - 1] + 1)
+                run++;
+            job.ext.rings(changed[begin], changed[run - 1] + 1, &S.mesh.vertices[changed[begin] * job.n], local.get());
+            begin = run;
+        }
+        local.merge(stats_lock);
+    });
+
+    if(stats != NULL) {
+        stats->triangles += S.mesh.faces.size();
+        stats->total_time += stats_clock() - start;
+    }
+
+    return S.mesh;
+}
+
+static void extrude_sink(const Polygon &poly, const SampleSource &full_path, const SampleSource &full_guide, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts) {
+    StridedSource path(full_path, opts.lod), guide(full_guide, opts.lod);
+
+    if(empty_extrusion(poly, path.size(), close_ends, opts))
+        return;
+
+    ExtrudeStats *stats = STATS(opts);
+    std::mutex stats_lock;
+    double start = stats != NULL ? stats_clock() : 0., t0 = 0.;
+
+    Arena local_arena;
+    Arena &arena = opts.arena != NULL ? *opts.arena : local_arena;
+    size_t arena_blocks = arena.blocks(), arena_capacity = arena.capacity();
+
+    Polygon storage;
+    Extruder ext(level_polygon(poly, close_ends, opts, storage), path, guide, opts.twist, arena);
+    size_t n = ext.refpoly.size(), m = path.size(), ncap = ext.cap.size();
+    // Dropping rings needs the next one, so simplification runs sequentially
+    int nthreads = opts.simplify ? 1 : thread_count(opts);
+    size_t block = block_rings(SINK_BLOCK, n);
+
+    /*
+     * All the buffers are carved out of the arena up front: a ring and the
+     * cap triangles, then either two rings, a block of rings and one strip,
+     * or a run of strips per worker and a block of rings for each worker,
+     * the last ring of the previous block included.
+     */
+    Point *ring = arena.alloc<Point>(n);
+    Triangle *cap = arena.alloc<Triangle>(ncap);
+    size_t per_round = nthreads > 1 ? nthreads * SINK_STRIPS_PER_THREAD : 1;
+    Triangle *strips = arena.alloc<Triangle>(2 * n * per_round);
+    Point *worker_rings = arena.alloc<Point>(n * (block + 1) * std::max(nthreads, 2));
+
+    if(stats != NULL) {
+        stats->setup_time += stats_clock() - start;
+        stats_arena(stats, arena, arena_blocks, arena_capacity);
+        stats_alloc(stats, ext.cap);
+        if(!opts.simplify)
+            stats->triangles += extrude_count(n, ncap, m, close_ends);
+        else if(close_ends)
+            stats->triangles += 2 * ncap;
+    }
+
+    if(close_ends && ncap > 0) {
+        ext.rings(0, 1, ring, stats);
+        ext.cap_triangles(ring, false, cap);
+        if(stats != NULL)
+            t0 = stats_clock();
+        sink.put(cap, ncap);
+        if(stats != NULL)
+            stats->output_time += stats_clock() - t0;
+    }
+
+    // The end cap is built on the last ring kept, welded vertices included
+    const Point *end_ring = NULL;
+
+    if(opts.simplify) {
+        simplify_rings<double>(n, m, block, worker_rings, [&](size_t begin, size_t end, Point *out) {
+            ext.rings(begin, end, out, stats);
+        }, [&](const Point *prev, const Point *cur) {
+            end_ring = cur;
+            if(prev == NULL)
+                return;
+
+            if(stats != NULL)
+                t0 = stats_clock();
+            size_t k = ext.welded_strip(prev, cur, strips);
+            if(stats != NULL) {
+                double t1 = stats_clock();
+                stats->strip_time += t1 - t0;
+                stats->triangles += k;
+                t0 = t1;
+            }
+
+            sink.put(strips, k);
+            if(stats != NULL)
+                stats->output_time += stats_clock() - t0;
+        });
+    } else if(nthreads <= 1) {
+        // Only a block of rings and one strip are alive at any time
+        Point *rings = worker_rings;
+
+        ext.rings(0, 1, rings, stats);
+
+        for(size_t b = 1; b < m; b += block) {
+            size_t e = std::min(m, b + block);
+            ext.rings(b, e, rings + n, stats);
+
+            for(size_t i = b; i < e; i++) {
+                if(stats != NULL)
+                    t0 = stats_clock();
+                ext.strip(rings + (i - b) * n, rings + (i - b + 1) * n, strips);
+                if(stats != NULL) {
+                    double t1 = stats_clock();
+                    stats->strip_time += t1 - t0;
+                    t0 = t1;
+                }
+
+                sink.put(strips, 2 * n);
+                if(stats != NULL)
+                    stats->output_time += stats_clock() - t0;
+            }
+
+            std::copy(rings + (e - b) * n, rings + (e - b + 1) * n, rings);
+        }
+    } else {
+        /*
+         * Each round, every worker extrudes a contiguous run of strips into
+         * its part of a shared buffer, recomputing the ring at the start of
+         * its run. The buffer is then handed to the sink in path order.
+         */
+        for(size_t round = 1; round < m; round += per_round) {
+            size_t round_end = std::min(m, round + per_round);
+
+            parallel_chunks(round, round_end, nthreads, [&](int t, size_t begin, size_t end) {
+                LocalStats local(stats);
+                ExtrudeStats *st = local.get();
+                Point *rings = worker_rings + (block + 1) * n * t;
+
+                ext.rings(begin - 1, begin, rings, st);
+                for(size_t b = begin; b < end; b += block) {
+                    size_t e = std::min(end, b + block);
+                    ext.rings(b, e, rings + n, st);
+
+                    double t1 = st != NULL ? stats_clock() : 0.;
+                    for(size_t i = b; i < e; i++)
+                        ext.strip(rings + (i - b) * n, rings + (i - b + 1) * n, &strips[2 * n * (i - round)]);
+                    if(st != NULL)
+                        st->strip_time += stats_clock() - t1;
+
+                    std::copy(rings + (e - b) * n, rings + (e - b + 1) * n, rings);
+                }
+
+                local.merge(stats_lock);
+            });
+
+            if(stats != NULL)
+                t0 = stats_clock();
+            sink.put(strips, 2 * n * (round_end - round));
+            if(stats != NULL)
+                stats->output_time += stats_clock() - t0;
+        }
+    }
+
+    if(close_ends && ncap > 0) {
+        if(end_ring == NULL) {
+            ext.rings(m - 1, m, ring, stats);
+            end_ring = ring;
+        }
+        ext.cap_triangles(end_ring, true, cap);
+        if(stats != NULL)
+            t0 = stats_clock();
+        sink.put(cap, ncap);
+        if(stats != NULL)
+            stats->output_time += stats_clock() - t0;
+    }
+
+    if(stats != NULL)
+        stats->total_time += stats_clock() - start;
+}
+
+/*
+ * Sink appending facets to a mapped file
+ */
+class MappingSink: public TriangleSink {
+public:
+    STLMapping &file;
+    size_t count;
+
+    MappingSink(STLMapping &file): file(file), count(0) {}
+
+    void put(const Triangle *triangles, size_t n) {
+        this->file.put(this->count, triangles, n);
+        this->count += n;
+    }
+};
+
+// Ring vertices computed at once by each worker of a mapped extrusion
+#define MAPPED_BLOCK 4096
+
+/*
+ * Extrusion into a file mapped in memory. Each worker extrudes a
+ * contiguous run of strips, computing its rings by blocks of about
+ * MAPPED_BLOCK vertices which the output writes at their final offsets;
+ * only those and one strip per worker are held in memory.
+ */
+class MappedExtrusion {
+public:
+    Extruder ext;
+    size_t n, m, ncap, block;
+    int nthreads;
+
+    MappedExtrusion(const Polygon &poly, const SampleSource &path, const SampleSource &guide, bool close_ends, const ExtrudeOptions &opts, Arena &arena);
+
+    template<class F>
+    void run(ExtrudeStats *stats, F f);
+
+private:
+    Point *worker_rings;
+};
+
+MappedExtrusion::MappedExtrusion(const Polygon &poly, const SampleSource &path, const SampleSource &guide, bool close_ends, const ExtrudeOptions &opts, Arena &arena):
+    ext(poly, path, guide, opts.twist, arena) {
+    this->n = this->ext.refpoly.size();
+    this->m = path.size();
+    this->ncap = close_ends ? this->ext.cap.size() : 0;
+    this->block = block_rings(MAPPED_BLOCK, this->n);
+    this->nthreads = std::max(1, std::min(thread_count(opts), (int)this->m - 1));
+
+    // Each block of rings starts with the last one of the previous block
+    this->worker_rings = arena.alloc<Point>((this->block + 1) * this->n * this->nthreads);
+}
+
+/*
+ * Call f(worker, begin, end, rings, stats) for blocks of rings [begin, end)
+ * covering [1, m), ring begin - 1 being at rings and the others following
+ */
+template<class F>
+void MappedExtrusion::run(ExtrudeStats *stats, F f) {
+    std::mutex stats_lock;
+    size_t n = this->n, block = this->block;
+
+    parallel_chunks(1, this->m, this->nthreads, [&](int t, size_t begin, size_t end) {
+        LocalStats local(stats);
+        ExtrudeStats *st = local.get();
+        Point *rings = this->worker_rings + (block + 1) * n * t;
+
+        this->ext.rings(begin - 1, begin, rings, st);
+        for(size_t b = begin; b < end; b += block) {
+            size_t e = std::min(end, b + block);
+            this->ext.rings(b, e, rings + n, st);
+            f(t, b, e, rings, st);
+            std::copy(rings + (e - b) * n, rings + (e - b + 1) * n, rings);
+        }
+
+        local.merge(stats_lock);
+    });
+}
+
+/*
+ * The layout of the STL file is the one of the mesh: start cap, strips in
+ * path order, end cap
+ */
+static bool extrude_stl_mapped(const Polygon &poly, const SampleSource &full_path, const SampleSource &full_guide, bool close_ends, const char *fname, const char *name, const ExtrudeOptions &opts) {
+    StridedSource path(full_path, opts.lod), guide(full_guide, opts.lod);
+    STLMapping file;
+
+    if(empty_extrusion(poly, path.size(), close_ends, opts))
+        return file.open(fname, name, 0) && file.finish(0);
+
+    Polygon storage;
+    const Polygon &level = level_polygon(poly, close_ends, opts, storage);
+
+    if(opts.simplify) {
+        // The rings dropped are only known on the way: append, then cut
+        if(!file.open(fname, name, extrude_count(level.size(), cap_count(level), path.size(), close_ends)))
+            return false;
+
+        MappingSink sink(file);
+        extrude_sink(poly, full_path, full_guide, close_ends, sink, opts);
+        return file.finish(sink.count);
+    }
+
+    ExtrudeStats *stats = STATS(opts);
+    double start = stats != NULL ? stats_clock() : 0., t0 = 0.;
+
+    Arena local_arena;
+    Arena &arena = opts.arena != NULL ? *opts.arena : local_arena;
+    size_t arena_blocks = arena.blocks(), arena_capacity = arena.capacity();
+
+    MappedExtrusion job(level, path, guide, close_ends, opts, arena);
+    size_t n = job.n, m = job.m, ncap = job.ncap;
+    size_t count = extrude_count(n, job.ext.cap.size(), m, close_ends);
+
+    // Caps have fewer than 2n triangles, so they fit in a strip buffer
+    Point *ring = arena.alloc<Point>(n);
+    Triangle *strips = arena.alloc<Triangle>(2 * n * job.nthreads);
+
+    if(stats != NULL) {
+        stats->setup_time += stats_clock() - start;
+        stats_arena(stats, arena, arena_blocks, arena_capacity);
+        stats_alloc(stats, job.ext.cap);
+        stats->triangles += count;
+        t0 = stats_clock();
+    }
+
+    if(!file.open(fname, name, count))
+        return false;
+
+    if(stats != NULL)
+        stats->output_time += stats_clock() - t0;
+
+    if(ncap > 0) {
+        job.ext.rings(0, 1, ring, stats);
+        job.ext.cap_triangles(ring, false, strips);
+        file.put(0, strips, ncap);
+        job.ext.rings(m - 1, m, ring, stats);
+        job.ext.cap_triangles(ring, true, strips);
+        file.put(count - ncap, strips, ncap);
+    }
+
+    job.run(stats, [&](int t, size_t begin, size_t end, const Point *rings, ExtrudeStats *st) {
+        Triangle *strip = strips + 2 * n * t;
+
+        for(size_t i = begin; i < end; i++) {
+            double t1 = st != NULL ? stats_clock() : 0.;
+            job.ext.strip(rings + (i - begin) * n, rings + (i - begin + 1) * n, strip);
+            double t2 = st != NULL ? stats_clock() : 0.;
+            file.put(ncap + 2 * n * (i - 1), strip, 2 * n);
+            if(st != NULL) {
+                st->strip_time += t2 - t1;
+                st->output_time += stats_clock() - t2;
+            }
+        }
+    });
+
+    if(stats != NULL)
+        t0 = stats_clock();
+
+    bool ok = file.finish(count);
+
+    if(stats != NULL) {
+        double t1 = stats_clock();
+        stats->output_time += t1 - t0;
+        stats->total_time += t1 - start;
+    }
+
+    return ok;
+}
+
+/*
+ * The PLY file holds the vertices and faces of the mesh, in the same order.
+ * Faces only depend on the ring layout, so each worker writes those of its
+ * strips along with its rings.
+ */
+static bool extrude_ply_mapped(const Polygon &poly, const SampleSource &full_path, const SampleSource &full_guide, bool close_ends, const char *fname, const char *name, const ExtrudeOptions &opts) {
+    StridedSource path(full_path, opts.lod), guide(full_guide, opts.lod);
+    PLYMapping file;
+
+    if(empty_extrusion(poly, path.size(), close_ends, opts))
+        return file.open(fname, name, 0, 0) && file.finish();
+
+    // The vertices kept are only known at the end
+    if(opts.simplify) {
+        Mesh mesh = extrude_mesh<double>(poly, full_path, full_guide, close_ends, opts);
+        return write_ply_binary(fname, name, mesh);
+    }
+
+    ExtrudeStats *stats = STATS(opts);
+    double start = stats != NULL ? stats_clock() : 0., t0 = 0.;
+
+    Arena local_arena;
+    Arena &arena = opts.arena != NULL ? *opts.arena : local_arena;
+    size_t arena_blocks = arena.blocks(), arena_capacity = arena.capacity();
+
+    Polygon storage;
+    MappedExtrusion job(level_polygon(poly, close_ends, opts, storage), path, guide, close_ends, opts, arena);
+    size_t n = job.n, m = job.m, ncap = job.ncap;
+    size_t count = extrude_count(n, job.ext.cap.size(), m, close_ends);
+
+    Point *ring = arena.alloc<Point>(n);
+    Face *strips = arena.alloc<Face>(2 * n * job.nthreads);
+
+    if(stats != NULL) {
+        stats->setup_time += stats_clock() - start;
+        stats_arena(stats, arena, arena_blocks, arena_capacity);
+        stats_alloc(stats, job.ext.cap);
+        stats->triangles += count;
+        t0 = stats_clock();
+    }
+
+    if(!file.open(fname, name, m * n, count))
+        return false;
+
+    if(stats != NULL)
+        stats->output_time += stats_clock() - t0;
+
+    job.ext.rings(0, 1, ring, stats);
+    file.put_vertices(0, ring, n);
+    if(ncap > 0) {
+        job.ext.cap_faces(0, false, strips);
+        file.put_faces(0, strips, ncap);
+        job.ext.cap_faces((m - 1) * n, true, strips);
+        file.put_faces(count - ncap, strips, ncap);
+    }
+
+    job.run(stats, [&](int t, size_t begin, size_t end, const Point *rings, ExtrudeStats *st) {
+        Face *strip = strips + 2 * n * t;
+        double t1 = st != NULL ? stats_clock() : 0.;
+
+        file.put_vertices(begin * n, rings + n, (end - begin) * n);
+        for(size_t i = begin; i < end; i++) {
+            job.ext.strip_faces((i - 1) * n, i * n, strip);
+            file.put_faces(ncap + 2 * n * (i - 1), strip, 2 * n);
+        }
+
+        if(st != NULL)
+            st->output_time += stats_clock() - t1;
+    });
+
+    if(stats != NULL)
+        t0 = stats_clock();
+
+    bool ok = file.finish();
+
+    if(stats != NULL) {
+        double t1 = stats_clock();
+        stats->output_time += t1 - t0;
+        stats->total_time += t1 - start;
+    }
+
+    return ok;
+}
+
+size_t path_extrude_count(const Polygon &poly, const Path &path, bool close_ends) {
+    return extrude_count(ring_size(poly, close_ends), cap_count(poly), path.size(), close_ends);
+}
+
+size_t path_extrude_count(const Polygon &poly, const LazyPath &path, bool close_ends) {
+    return extrude_count(ring_size(poly, close_ends), cap_count(poly), path.size(), close_ends);
+}
+
+Mesh path_extrude_mesh(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_mesh<double>(poly, StoredSource(path), StoredSource(guide), close_ends, opts);
+}
+
+Mesh path_extrude_mesh(const Polygon &poly, const Path &path, const Path &guide, bool close_ends) {
+    return path_extrude_mesh(poly, path, guide, close_ends, ExtrudeOptions());
+}
+
+Mesh path_extrude_mesh(const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_mesh<double>(poly, LazySource(path), LazySource(guide), close_ends, opts);
+}
+
+Mesh path_extrude_mesh(const Polygon &poly, const Path &path, bool close_ends, const ExtrudeOptions &opts) {
+    return path_extrude_mesh(poly, path, Path(), close_ends, opts);
+}
+
+Mesh path_extrude_mesh(const Polygon &poly, const LazyPath &path, bool close_ends, const ExtrudeOptions &opts) {
+    return path_extrude_mesh(poly, path, LazyPath(), close_ends, opts);
+}
+
+Meshf path_extrude_meshf(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_mesh<float>(poly, StoredSource(path), StoredSource(guide), close_ends, opts);
+}
+
+Meshf path_extrude_meshf(const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_mesh<float>(poly, LazySource(path), LazySource(guide), close_ends, opts);
+}
+
+std::vector<Mesh> path_extrude_batch(const std::vector<ExtrudeJob> &jobs, const ExtrudeOptions &opts) {
+    return extrude_batch(jobs, opts);
+}
+
+void path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts) {
+    extrude_sink(poly, StoredSource(path), StoredSource(guide), close_ends, sink, opts);
+}
+
+void path_extrude(const Polygon &poly, const Path &path, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts) {
+    path_extrude(poly, path, Path(), close_ends, sink, opts);
+}
+
+void path_extrude(const Polygon &poly, const LazyPath &path, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts) {
+    path_extrude(poly, path, LazyPath(), close_ends, sink, opts);
+}
+
+void path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, TriangleSink &sink) {
+    path_extrude(poly, path, guide, close_ends, sink, ExtrudeOptions());
+}
+
+void path_extrude(const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts) {
+    extrude_sink(poly, LazySource(path), LazySource(guide), close_ends, sink, opts);
+}
+
+Object path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return path_extrude_mesh(poly, path, guide, close_ends, opts).ToObject();
+}
+
+Object path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends) {
+    return path_extrude(poly, path, guide, close_ends, ExtrudeOptions());
+}
+
+bool path_extrude_stl(const char *fname, const char *name, const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_stl_mapped(poly, StoredSource(path), StoredSource(guide), close_ends, fname, name, opts);
+}
+
+bool path_extrude_stl(const char *fname, const char *name, const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_stl_mapped(poly, LazySource(path), LazySource(guide), close_ends, fname, name, opts);
+}
+
+bool path_extrude_ply(const char *fname, const char *name, const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_ply_mapped(poly, StoredSource(path), StoredSource(guide), close_ends, fname, name, opts);
+}
+
+bool path_extrude_ply(const char *fname, const char *name, const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts) {
+    return extrude_ply_mapped(poly, LazySource(path), LazySource(guide), close_ends, fname, name, opts);
+}
@@ -21,9 +21,214 @@
 #ifndef _I_PATH_EXTRUDE_H_
 #define _I_PATH_EXTRUDE_H_
 
+#include "arena.h"
 #include "geometry.h"
+#include "path_gen.h"
 
-Object path_extrude(Polygon poly, Path path, Path guide, bool close_ends);
+#include <cstdio>
+#include <memory>
+
+/*
+ * Where the time goes in one or more extrusions. Times are in seconds and
+ * summed over worker threads. Rings and vertices count every ring computed,
+ * including those computed twice at chunk boundaries. Allocation counters
+ * cover the memory obtained from the system by the extrusion itself: output
+ * arrays, cap triangulation and arena blocks. Everything accumulates over
+ * calls until clear().
+ */
+class ExtrudeStats {
+public:
+    double setup_time;      // reference frame, Matrix::Invert, cap triangulation
+    double frame_time;      // per-ring frame construction (including lazy path evaluation)
+    double transform_time;  // transformation of the polygon into rings
+    double strip_time;      // triangulation of strips and caps
+    double output_time;     // output allocation and sink calls
+    double total_time;      // wall time of the whole call
+
+    size_t rings, vertices, triangles;
+    size_t allocations, bytes;
+
+    ExtrudeStats();
+
+    void clear();
+    void add(const ExtrudeStats &S);
+    void WriteJSON(FILE *fd);
+};
+
+class ExtrudeOptions {
+public:
+    // Number of worker threads, 0 for one per core. The output does not
+    // depend on it.
+    int threads;
+
+    // Record to fill with statistics, NULL to skip instrumentation
+    ExtrudeStats *stats;
+
+    // Arena for the temporaries of the extrusion, NULL for one owned by the
+    // call. A caller-supplied arena is not reset by the extrusion, so that
+    // reusing it across calls avoids going back to the system allocator.
+    Arena *arena;
+
+    // Rotation of rotation-minimizing frames around the path, in radians
+    // per unit of path length. Only used without a guide.
+    double twist;
+
+    // Drop repeated polygon points and the rings lying on the flat strip
+    // between their neighbours (straight runs of the path), and merge the
+    // strips around them. Ring vertices coinciding with those of the
+    // previous ring are welded and the triangles they collapse dropped.
+    // The surface is unchanged, with fewer triangles. Runs sequentially.
+    bool simplify;
+
+    // Level of detail: only every 2^lod-th path sample (and the last one)
+    // and polygon vertex are extruded, 0 for the full extrusion. Coarse
+    // levels are meant for previews.
+    int lod;
+
+    ExtrudeOptions();
+};
+
+/*
+ * Inputs of one extrusion
+ */
+class ExtrudeJob {
+public:
+    Polygon poly;
+    Path path, guide;       // an empty guide selects rotation-minimizing frames
+    bool close_ends;
+
+    ExtrudeJob(): close_ends(false) {}
+};
+
+/*
+ * Number of triangles of an extrusion, an upper bound with opts.simplify
+ * or opts.lod
+ */
+size_t path_extrude_count(const Polygon &poly, const Path &path, bool close_ends);
+size_t path_extrude_count(const Polygon &poly, const LazyPath &path, bool close_ends);
+
+Mesh path_extrude_mesh(const Polygon &poly, const Path &path, const Path &guide, bool close_ends);
+Mesh path_extrude_mesh(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts);
+Object path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends);
+Object path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts);
+
+/*
+ * Guide-free variants: the polygon is swept along rotation-minimizing
+ * frames computed from the path tangents, starting from an arbitrary
+ * normal at the first sample. The same happens with an empty guide.
+ */
+Mesh path_extrude_mesh(const Polygon &poly, const Path &path, bool close_ends, const ExtrudeOptions &opts);
+Mesh path_extrude_mesh(const Polygon &poly, const LazyPath &path, bool close_ends, const ExtrudeOptions &opts);
+void path_extrude(const Polygon &poly, const Path &path, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts);
+void path_extrude(const Polygon &poly, const LazyPath &path, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts);
+
+/*
+ * Extrude independent jobs on a work-stealing pool of opts.threads workers.
+ * Large jobs are split into ranges of rings, so that a single big job keeps
+ * every worker busy. Meshes come back in job order and are the same as
+ * those of path_extrude_mesh. Each job uses its own arena; opts.arena is
+ * ignored.
+ */
+std::vector<Mesh> path_extrude_batch(const std::vector<ExtrudeJob> &jobs, const ExtrudeOptions &opts);
+
+/*
+ * Extrude straight into a binary STL file. The file is sized from the
+ * triangle count and mapped in memory, and the workers write their strips
+ * as facets at their final offsets: no mesh is built, and memory use
+ * depends on the polygon size only. The file is the same as the one
+ * written from path_extrude_mesh. With opts.simplify, facets are appended
+ * in order instead and the file is cut to size at the end.
+ */
+bool path_extrude_stl(const char *fname, const char *name, const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts);
+bool path_extrude_stl(const char *fname, const char *name, const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts);
+
+/*
+ * The same into an indexed binary PLY file, each ring vertex being written
+ * once. With opts.simplify, the mesh is built first and then written.
+ */
+bool path_extrude_ply(const char *fname, const char *name, const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts);
+bool path_extrude_ply(const char *fname, const char *name, const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts);
+
+/*
+ * Coarse-to-fine extrusion for interactive previews. The mesh of each
+ * level is the one of path_extrude_mesh with opts.lod set to it; rings are
+ * computed once at full resolution and kept, so that refining only
+ * computes those the coarser levels skipped.
+ */
+class ProgressiveExtrusion {
+public:
+    ProgressiveExtrusion(Polygon poly, Path path, Path guide, bool close_ends, const ExtrudeOptions &opts);
+    ~ProgressiveExtrusion();
+
+    // Number of levels, the coarsest one being levels() - 1
+    int levels() const;
+
+    Mesh mesh(int level);
+
+private:
+    class State;
+    std::unique_ptr<State> state;
+
+    ProgressiveExtrusion(const ProgressiveExtrusion &);
+    ProgressiveExtrusion &operator =(const ProgressiveExtrusion &);
+};
+
+/*
+ * Re-extrusion of a part being edited. Each update returns the mesh of
+ * path_extrude_mesh for its inputs, patched from the previous one: only
+ * the rings whose path or guide sample changed are recomputed (all those
+ * from the first change on without a guide, as frames are propagated
+ * along the path, and only from there), and the strips around them follow
+ * since faces refer to ring vertices. Changing the polygon or close_ends
+ * keeps the frames and maps every ring again. Changing the first sample of
+ * the path or guide recomputes everything. With opts.simplify or opts.lod
+ * every update is a full extrusion.
+ */
+class IncrementalExtrusion {
+public:
+    IncrementalExtrusion(const ExtrudeOptions &opts);
+    ~IncrementalExtrusion();
+
+    const Mesh &update(const Polygon &poly, const Path &path, const Path &guide, bool close_ends);
+
+    // Same, where only the samples [begin, end) and those past the end of
+    // the last path may differ from the last update: the others are not
+    // compared, so that a local edit costs nothing per unchanged sample
+    const Mesh &update(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, size_t begin, size_t end);
+
+    // Mesh of the last update
+    const Mesh &mesh() const;
+
+private:
+    class State;
+    std::unique_ptr<State> state;
+
+    IncrementalExtrusion(const IncrementalExtrusion &);
+    IncrementalExtrusion &operator =(const IncrementalExtrusion &);
+};
+
+/*
+ * Streaming variant: the triangles between each pair of rings are handed
+ * to the sink as soon as they are generated, so memory use depends on the
+ * polygon size only.
+ */
+void path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, TriangleSink &sink);
+void path_extrude(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts);
+
+/*
+ * Lazy variants: path and guide samples are generated while extruding,
+ * without materializing either path.
+ */
+Mesh path_extrude_mesh(const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts);
+void path_extrude(const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, TriangleSink &sink, const ExtrudeOptions &opts);
+
+/*
+ * Single precision output: paths and frames are still computed in double,
+ * but the ring vertices are transformed and stored as float, halving the
+ * size of the mesh.
+ */
+Meshf path_extrude_meshf(const Polygon &poly, const Path &path, const Path &guide, bool close_ends, const ExtrudeOptions &opts);
+Meshf path_extrude_meshf(const Polygon &poly, const LazyPath &path, const LazyPath &guide, bool close_ends, const ExtrudeOptions &opts);
 
 #endif
 
@@ -0,0 +1,322 @@
+/*
+ * path_gen.cxx - Lazy path generators
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "path_gen.h"
+#include "sincos.h"
+
+// Angles evaluated at once by the circular generators
+#define ANGLE_BLOCK (4 * SINCOS_RESEED)
+
+static inline Vector mul(const Matrix &M, const Vector &X) {
+    const double (*c)[3] = M.coeffs;
+    return Vector(c[0][0] * X.x + c[0][1] * X.y + c[0][2] * X.z,
+                  c[1][0] * X.x + c[1][1] * X.y + c[1][2] * X.z,
+                  c[2][0] * X.x + c[2][1] * X.y + c[2][2] * X.z);
+}
+
+static inline void put_sample(PathSample *out, const Point &P, const Vector &T, const Affine *A) {
+    if(A == NULL) {
+        out->first = P;
+        out->second = T;
+    } else {
+        Vector MP = mul(A->M, P);
+        out->first = MP + A->t;
+        out->second = mul(A->M, T);
+    }
+}
+
+class ListGen: public PathGen {
+public:
+    Path path;
+
+    ListGen(const Path &p): path(p) {}
+
+    size_t size() const {
+        return this->path.size();
+    }
+
+    void eval(size_t begin, size_t end, const Affine *A, PathSample *out) const {
+        for(size_t i = begin; i < end; i++)
+            put_sample(out++, this->path[i].first, this->path[i].second, A);
+    }
+};
+
+class LineGen: public PathGen {
+public:
+    Point start;
+    Vector dir, dv;
+    int npoints;
+
+    LineGen(const Point &start, const Point &end, int npoints) {
+        this->start = start;
+        this->dir = end - start;
+        this->dv = 1. / (npoints-1.) * this->dir;
+        this->npoints = npoints;
+    }
+
+    size_t size() const {
+        return this->npoints;
+    }
+
+    void eval(size_t begin, size_t end, const Affine *A, PathSample *out) const {
+        Point start(this->start);
+
+        for(size_t i = begin; i < end; i++) {
+            Point P(start + (double)i * this->dv);
+            put_sample(out++, P, this->dir, A);
+        }
+    }
+};
+
+class HelixGen: public PathGen {
+public:
+    double start_angle, dt, radius, dz, slope;
+    Point center;
+    int npoints;
+
+    HelixGen(double start_angle, double end_angle, double radius, double height, const Point &center, int npoints) {
+        this->start_angle = start_angle;
+        this->dt = (end_angle - start_angle) / (npoints-1.);
+        this->radius = radius;
+        this->dz = height / (npoints-1.);
+        this->slope = height != 0. ? this->dz / this->dt : 0.;
+        this->center = center;
+        this->npoints = npoints;
+    }
+
+    size_t size() const {
+        return this->npoints;
+    }
+
+    void eval(size_t begin, size_t end, const Affine *A, PathSample *out) const {
+        double r = this->radius;
+        Point center(this->center);
+        double c[ANGLE_BLOCK], s[ANGLE_BLOCK];
+
+        for(size_t i0 = begin; i0 < end; i0 += ANGLE_BLOCK) {
+            size_t i1 = std::min(end, i0 + ANGLE_BLOCK);
+            sincos_sequence(this->start_angle, this->dt, i0, i1, c, s);
+
+            for(size_t i = i0; i < i1; i++) {
+                double z = i*this->dz;
+                Vector V(r * c[i-i0], r * s[i-i0], z);
+                Vector T(-r * s[i-i0], r * c[i-i0], this->slope);
+
+                put_sample(out++, center + V, T, A);
+            }
+        }
+    }
+};
+
+class EllArcGen: public PathGen {
+public:
+    double a, b, phi, dt;
+    Point center;
+    Matrix R;
+    int npoints;
+
+    EllArcGen(double start_angle, double end_angle, double a, double b, const Point &center, int npoints) {
+        double c = std::cos(start_angle), s = -std::sin(start_angle);
+
+        this->a = a;
+        this->b = b;
+        this->dt = (end_angle - start_angle) / (npoints - 1.);
+        this->phi = std::atan(a/b * std::tan(start_angle));
+        this->center = center;
+        this->R.AssignColumns(Vector(c, s, 0.), Vector(-s, c, 0.), Vector(0., 0., 1.));
+        this->npoints = npoints;
+    }
+
+    size_t size() const {
+        return this->npoints;
+    }
+
+    void eval(size_t begin, size_t end, const Affine *A, PathSample *out) const {
+        Matrix R(this->R);
+        Point center(this->center);
+        double c[ANGLE_BLOCK], s[ANGLE_BLOCK];
+
+        for(size_t i0 = begin; i0 < end; i0 += ANGLE_BLOCK) {
+            size_t i1 = std::min(end, i0 + ANGLE_BLOCK);
+            sincos_sequence(this->phi, this->dt, i0, i1, c, s);
+
+            for(size_t i = i0; i < i1; i++) {
+                Vector V(this->a * c[i-i0], this->b * s[i-i0], 0.);
+                Vector T(-this->a * s[i-i0], this->b * c[i-i0], 0.);
+
+                put_sample(out++, center + R*V, R*T, A);
+            }
+        }
+    }
+};
+
+class ConcatGen: public PathGen {
+public:
+    std::vector<LazyPath> parts;
+    std::vector<size_t> offsets;
+
+    void append(const LazyPath &p) {
+        this->offsets.push_back(this->size());
+        this->parts.push_back(p);
+    }
+
+    size_t size() const {
+        if(this->parts.empty())
+            return 0;
+        return this->offsets.back() + this->parts.back().size();
+    }
+
+    void eval(size_t begin, size_t end, const Affine *A, PathSample *out) const {
+        size_t k = std::upper_bound(this->offsets.begin(), this->offsets.end(), begin) - this->offsets.begin() - 1;
+
+        for(; begin < end; k++) {
+            const LazyPath &part = this->parts[k];
+            size_t off = this->offsets[k];
+            size_t part_end = std::min(end, off + part.size());
+
+            // Fuse the part's own transform with the outer one
+            if(!part.transformed) {
+                part.gen->eval(begin - off, part_end - off, A, out);
+            } else if(A == NULL) {
+                part.gen->eval(begin - off, part_end - off, &part.affine, out);
+            } else {
+                Affine AP = *A * part.affine;
+                part.gen->eval(begin - off, part_end - off, &AP, out);
+            }
+
+            out += part_end - begin;
+            begin = part_end;
+        }
+    }
+};
+
+LazyPath::LazyPath() {
+    this->transformed = false;
+}
+
+LazyPath::LazyPath(std::shared_ptr<const PathGen> gen) {
+    this->gen = gen;
+    this->transformed = false;
+}
+
+size_t LazyPath::size() const {
+    return this->gen ? this->gen->size() : 0;
+}
+
+bool LazyPath::empty() const {
+    return this->size() == 0;
+}
+
+void LazyPath::eval(size_t begin, size_t end, PathSample *out) const {
+    this->gen->eval(begin, end, this->transformed ? &this->affine : NULL, out);
+}
+
+PathSample LazyPath::operator [](size_t i) const {
+    PathSample s;
+    this->eval(i, i + 1, &s);
+    return s;
+}
+
+Path LazyPath::materialize() const {
+    Path path(this->size());
+
+    if(!path.empty())
+        this->eval(0, path.size(), &path[0]);
+
+    return path;
+}
+
+LazyPath LazyPath::transform(const Affine &A) const {
+    LazyPath res(*this);
+
+    res.affine = this->transformed ? A * this->affine : A;
+    res.transformed = true;
+
+    return res;
+}
+
+LazyPath lazy_path(const Path &p) {
+    return LazyPath(std::make_shared<ListGen>(p));
+}
+
+LazyPath lazy_line(const Point &start, const Point &end, int npoints) {
+    return LazyPath(std::make_shared<LineGen>(start, end, npoints));
+}
+
+LazyPath lazy_arc(double start_angle, double end_angle, double radius, const Point &center, int npoints) {
+    return LazyPath(std::make_shared<HelixGen>(start_angle, end_angle, radius, 0., center, npoints));
+}
+
+LazyPath lazy_helix(double start_angle, double end_angle, double radius, double height, const Point &center, int npoints) {
+    return LazyPath(std::make_shared<HelixGen>(start_angle, end_angle, radius, height, center, npoints));
+}
+
+LazyPath lazy_ell_arc(double start_angle, double end_angle, double a, double b, const Point &center, int npoints) {
+    return LazyPath(std::make_shared<EllArcGen>(start_angle, end_angle, a, b, center, npoints));
+}
+
+LazyPath lazy_concat(const LazyPath &p1, const LazyPath &p2) {
+    std::shared_ptr<ConcatGen> cat = std::make_shared<ConcatGen>();
+    const LazyPath *ps[2] = {&p1, &p2};
+
+    for(int i = 0; i < 2; i++) {
+        const ConcatGen *sub = dynamic_cast<const ConcatGen *>(ps[i]->gen.get());
+
+        if(sub != NULL && !ps[i]->transformed) {
+            for(size_t k = 0; k < sub->parts.size(); k++)
+                cat->append(sub->parts[k]);
+        } else if(!ps[i]->empty()) {
+            cat->append(*ps[i]);
+        }
+    }
+
+    return LazyPath(cat);
+}
+
+LazyPath lazy_translate(const LazyPath &p, const Vector &v) {
+    return p.transform(Affine::Translation(v));
+}
+
+LazyPath lazy_transform(const LazyPath &p, const Matrix &M) {
+    return p.transform(Affine::Linear(M));
+}
+
+LazyPath lazy_transform(const LazyPath &p, const Affine &A) {
+    return p.transform(A);
+}
+
+LazyPath lazy_scale(const LazyPath &p, const Vector &k) {
+    return p.transform(Affine::Scale(k));
+}
+
+LazyPath lazy_scale(const LazyPath &p, double k) {
+    return lazy_scale(p, Vector(k, k, k));
+}
+
+LazyPath lazy_rotate(const LazyPath &p, const Vector &angles) {
+    return p.transform(Affine::RotationYPR(angles));
+}
+
+LazyPath lazy_rotate(const LazyPath &p, double angle, const Vector &n) {
+    return p.transform(Affine::Rotation(angle, n));
+}
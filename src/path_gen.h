@@ -0,0 +1,85 @@
+/*
+ * path_gen.h - Lazy path generators
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_PATH_GEN_H_
+#define _I_PATH_GEN_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "geometry.h"
+#include "matrix.h"
+
+typedef std::pair<Point, Vector> PathSample;
+
+/*
+ * Source of path samples computed on demand. The samples [begin, end) are
+ * written to out after going through the affine map A (tangents only go
+ * through its linear part). A == NULL stands for the identity.
+ */
+class PathGen {
+public:
+    virtual ~PathGen() {}
+
+    virtual size_t size() const = 0;
+    virtual void eval(size_t begin, size_t end, const Affine *A, PathSample *out) const = 0;
+};
+
+/*
+ * Handle on a path generator, with a pending affine transform. Transforms
+ * compose into a single matrix and concatenations are flattened, so a
+ * chain of operations is evaluated in one pass when samples are needed.
+ */
+class LazyPath {
+public:
+    LazyPath();
+    LazyPath(std::shared_ptr<const PathGen> gen);
+
+    size_t size() const;
+    bool empty() const;
+
+    void eval(size_t begin, size_t end, PathSample *out) const;
+    PathSample operator [](size_t i) const;
+    Path materialize() const;
+
+    LazyPath transform(const Affine &A) const;
+
+    std::shared_ptr<const PathGen> gen;
+    bool transformed;
+    Affine affine;
+};
+
+LazyPath lazy_path(const Path &p);
+LazyPath lazy_line(const Point &start, const Point &end, int npoints);
+LazyPath lazy_arc(double start_angle, double end_angle, double radius, const Point &center, int npoints);
+LazyPath lazy_helix(double start_angle, double end_angle, double radius, double height, const Point &center, int npoints);
+LazyPath lazy_ell_arc(double start_angle, double end_angle, double a, double b, const Point &center, int npoints);
+
+LazyPath lazy_concat(const LazyPath &p1, const LazyPath &p2);
+LazyPath lazy_translate(const LazyPath &p, const Vector &v);
+LazyPath lazy_transform(const LazyPath &p, const Matrix &M);
+LazyPath lazy_transform(const LazyPath &p, const Affine &A);
+LazyPath lazy_scale(const LazyPath &p, const Vector &k);
+LazyPath lazy_scale(const LazyPath &p, double k);
+LazyPath lazy_rotate(const LazyPath &p, const Vector &angles);
+LazyPath lazy_rotate(const LazyPath &p, double angle, const Vector &n);
+
+#endif
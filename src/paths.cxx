@@ -20,132 +20,214 @@
 
 #include "geometry.h"
 #include "matrix.h"
+#include "path_gen.h"
 #include "paths.h"
 
+#include <algorithm>
 #include <cmath>
+#include <utility>
 
-Path path_line(Point start, Point end, int npoints) {
-    Path path;
-    Vector dir(end - start);
-    Vector dv = 1. / (npoints-1.) * dir;
+Path path_line(const Point &start, const Point &end, int npoints) {
+    return lazy_line(start, end, npoints).materialize();
+}
 
-    for(int i = 0; i < npoints; i++) {
-        Point P(start + i*dv);
-        path.push_back(std::make_pair(P, dir));
-    }
+Path path_arc(double start_angle, double end_angle, double radius, const Point &center, int npoints) {
+    return lazy_arc(start_angle, end_angle, radius, center, npoints).materialize();
+}
 
-    return path;
+Path path_helix(double start_angle, double end_angle, double radius, double height, const Point &center, int npoints) {
+    return lazy_helix(start_angle, end_angle, radius, height, center, npoints).materialize();
 }
 
-Path path_arc(double start_angle, double end_angle, double radius, Point center, int npoints) {
-    Path path;
-    double t = 0, dt = (end_angle - start_angle) / (npoints-1.);
+Path path_ell_arc(double start_angle, double end_angle, double a, double b, const Point &center, int npoints) {
+    return lazy_ell_arc(start_angle, end_angle, a, b, center, npoints).materialize();
+}
 
-    for(int i = 0; i < npoints; i++) {
-        t = start_angle + i*dt;
-        Vector V(radius * std::cos(t), radius * std::sin(t), 0.);
-        Vector T(-radius * std::sin(t), radius * std::cos(t), 0.);
+Path path_concat(const Path &p1, const Path &p2) {
+    Path res;
 
-        path.push_back(std::make_pair(center + V, T));
-    }
+    res.reserve(p1.size() + p2.size());
+    res.insert(res.end(), p1.begin(), p1.end());
+    res.insert(res.end(), p2.begin(), p2.end());
 
-    return path;
+    return res;
+}
+
+Path path_concat(Path &&p1, const Path &p2) {
+    path_append(p1, p2);
+    return std::move(p1);
 }
 
-Path path_helix(double start_angle, double end_angle, double radius, double height, Point center, int npoints) {
-    Path path;
-    double t = 0, dt = (end_angle - start_angle) / (npoints-1.);
-    double z = 0, dz = height / (npoints-1.);
+void path_append(Path &path, const Path &tail) {
+    path.insert(path.end(), tail.begin(), tail.end());
+}
+
+Path path_translate(Path p, const Vector &v) {
+    for(Path::iterator p_it = p.begin(); p_it != p.end(); p_it++)
+        p_it->first = p_it->first + v;
 
-    for(int i = 0; i < npoints; i++) {
-        t = start_angle + i*dt;
-        z = i*dz;
-        Vector V(radius * std::cos(t), radius * std::sin(t), z);
-        Vector T(-radius * std::sin(t), radius * std::cos(t), dz/dt);
+    return p;
+}
 
-        path.push_back(std::make_pair(center + V, T));
+Path path_transform(Path p, const Affine &A) {
+    for(Path::iterator p_it = p.begin(); p_it != p.end(); p_it++) {
+        p_it->first = A.apply_point(p_it->first);
+        p_it->second = A.apply_vector(p_it->second);
     }
 
-    return path;
+    return p;
 }
 
-Path path_ell_arc(double start_angle, double end_angle, double a, double b, Point center, int npoints) {
-    Path path;
-    double c = std::cos(start_angle), s = -std::sin(start_angle);
-    double t = 0, dt = (end_angle - start_angle) / (npoints - 1.);
-    double phi = std::atan(a/b * std::tan(start_angle));
+Path path_transform(Path p, const Matrix &M) {
+    return path_transform(std::move(p), Affine::Linear(M));
+}
 
-    Matrix R(Vector(c, s, 0.), Vector(-s, c, 0.), Vector(0., 0., 1.));
-    
-    for(int i = 0; i < npoints; i++) {
-        t = phi + i*dt;
-        Vector V(a * std::cos(t), b * std::sin(t), 0.);
-        Vector T(-a * std::sin(t), b * std::cos(t), 0.);
+Path path_scale(Path p, const Vector &k) {
+    return path_transform(std::move(p), Affine::Scale(k));
+}
 
-        path.push_back(std::make_pair(center + R*V, R*T));
-    }
+Path path_scale(Path p, double k) {
+    return path_scale(std::move(p), Vector(k, k, k));
+}
 
-    return path;
+Path path_rotate(Path p, const Vector &angles) {
+    return path_transform(std::move(p), Affine::RotationYPR(angles));
 }
 
-Path path_concat(Path p1, Path p2) {
-    Path res(p1);
+Path path_rotate(Path p, double angle, const Vector &n) {
+    return path_transform(std::move(p), Affine::Rotation(angle, n));
+}
 
-    for(Path::iterator p2_it = p2.begin(); p2_it != p2.end(); p2_it++)
-        res.push_back(*p2_it);
-    
-    return res;
+/*
+ * Largest parameter step on a circle of the given radius within tolerance:
+ * the sagitta of a chord spanning an angle t is radius * (1 - cos(t/2)).
+ */
+static double arc_step(double radius, double chord_tol, double angle_tol) {
+    double step = angle_tol;
+
+    if(chord_tol < radius)
+        step = std::min(step, 2. * std::acos(1. - chord_tol / radius));
+
+    return step;
 }
 
-Path path_translate(Path p, Vector v) {
-    Path res;
+int path_arc_npoints(double angle, double radius, double chord_tol, double angle_tol) {
+    double step = arc_step(std::fabs(radius), chord_tol, angle_tol);
+    return std::max(2, (int)std::ceil(std::fabs(angle) / step) + 1);
+}
 
-    for(Path::iterator p_it = p.begin(); p_it != p.end(); p_it++)
-        res.push_back(std::make_pair(p_it->first + v, p_it->second));
+Path path_line_adaptive(const Point &start, const Point &end) {
+    return path_line(start, end, 2);
+}
 
-    return res;
+Path path_arc_adaptive(double start_angle, double end_angle, double radius, const Point &center, double chord_tol, double angle_tol) {
+    int npoints = path_arc_npoints(end_angle - start_angle, radius, chord_tol, angle_tol);
+    return path_arc(start_angle, end_angle, radius, center, npoints);
 }
 
-Path path_transform(Path p, Matrix M) {
-    Path res;
+Path path_helix_adaptive(double start_angle, double end_angle, double radius, double height, const Point &center, double chord_tol, double angle_tol) {
+    // Radius of curvature of the helix, and tangent turning per radian
+    double angle = end_angle - start_angle;
+    double c = angle != 0. ? height / angle : 0.;
+    double rc = (radius * radius + c * c) / std::fabs(radius);
+    double turn = std::fabs(radius) / std::sqrt(radius * radius + c * c);
+    double step = arc_step(rc, chord_tol, angle_tol) / turn;
 
-    for(Path::iterator p_it = p.begin(); p_it != p.end(); p_it++)
-        res.push_back(std::make_pair(M * p_it->first, M * p_it->second));
+    int npoints = std::max(2, (int)std::ceil(std::fabs(angle) / step) + 1);
+    return path_helix(start_angle, end_angle, radius, height, center, npoints);
+}
 
-    return res;
+Path path_ell_arc_adaptive(double start_angle, double end_angle, double a, double b, const Point &center, double chord_tol, double angle_tol) {
+    // Bound the curvature by that of the tightest point of the ellipse
+    double lo = std::min(std::fabs(a), std::fabs(b)), hi = std::max(std::fabs(a), std::fabs(b));
+    double rmin = lo * lo / hi;
+    double step = std::min(arc_step(rmin, chord_tol, angle_tol) * rmin / hi, angle_tol * lo / hi);
+
+    int npoints = std::max(2, (int)std::ceil(std::fabs(end_angle - start_angle) / step) + 1);
+    return path_ell_arc(start_angle, end_angle, a, b, center, npoints);
 }
 
-Path path_scale(Path p, Vector k) {
-    Matrix M = Matrix::Diag(k);
-    return path_transform(p, M);
+static double angle_between(const Vector &U, const Vector &V) {
+    return std::atan2(Vector::cross(U, V).norm(), Vector::dot(U, V));
 }
 
-Path path_scale(Path p, double k) {
-    return path_scale(p, Vector(k, k, k));
+/*
+ * Upper estimate of the distance between a curve and its chord, from the
+ * chord length and the total tangent turning along the curve (exact for
+ * circular arcs)
+ */
+static double sagitta(double chord, double turn) {
+    return 0.5 * chord * std::tan(std::min(turn, M_PI) / 4.);
 }
 
-Path path_rotate(Path p, Vector angles) {
-    Matrix M = Matrix::RotationYPR(angles);
-    return path_transform(p, M);
+/*
+ * Greedy selection of samples: extend the current segment as long as it
+ * stays within tolerance, then restart it from the last acceptable sample.
+ */
+static std::vector<size_t> resample_indices(const Path &path, const Path *guide, double chord_tol, double angle_tol) {
+    std::vector<size_t> keep;
+    size_t m = path.size(), k = 0;
+    double turn = 0., gturn = 0., xturn = 0.;
+
+    if(m == 0)
+        return keep;
+
+    keep.push_back(0);
+
+    for(size_t j = 1; j < m; j++) {
+        double dturn = angle_between(path[j-1].second, path[j].second);
+        double dgturn = 0., dxturn = 0.;
+
+        if(guide != NULL) {
+            const Path &g = *guide;
+            dgturn = angle_between(g[j-1].second, g[j].second);
+            dxturn = angle_between(g[j-1].first - path[j-1].first, g[j].first - path[j].first);
+        }
+
+        turn += dturn;
+        gturn += dgturn;
+        xturn += dxturn;
+
+        bool ok = turn <= angle_tol && xturn <= angle_tol
+               && sagitta((path[j].first - path[k].first).norm(), turn) <= chord_tol;
+        if(guide != NULL) {
+            const Path &g = *guide;
+            ok = ok && gturn <= angle_tol
+                    && sagitta((g[j].first - g[k].first).norm(), gturn) <= chord_tol;
+        }
+
+        if(!ok && j - 1 > k) {
+            k = j - 1;
+            keep.push_back(k);
+            turn = dturn;
+            gturn = dgturn;
+            xturn = dxturn;
+        }
+    }
+
+    if(keep.back() != m - 1)
+        keep.push_back(m - 1);
+
+    return keep;
 }
 
-Path path_rotate(Path p, double angle, Vector n) {
-    Vector k = (1. / n.norm()) * n;
-    double c = std::cos(angle), s = std::sin(angle);
+static Path path_select(const Path &p, const std::vector<size_t> &indices) {
     Path res;
 
-    for(Path::iterator p_it = p.begin(); p_it != p.end(); p_it++) {
-        Vector a = p_it->first;
-        Vector b = p_it->second;
-        Vector cr_a = Vector::cross(k, a);
-        double d_a = Vector::dot(k, a);
-        Vector cr_b = Vector::cross(k, b);
-        double d_b = Vector::dot(k, b);
-        a = c * a + s * cr_a + d_a * (1 - c) * k;
-        b = c * b + s * cr_b + d_b * (1 - c) * k;
-        res.push_back(std::make_pair(a, b));
-    }
+    res.reserve(indices.size());
+    for(size_t i = 0; i < indices.size(); i++)
+        res.push_back(p[indices[i]]);
 
     return res;
 }
 
+Path path_resample(const Path &p, double chord_tol, double angle_tol) {
+    std::vector<size_t> keep = resample_indices(p, NULL, chord_tol, angle_tol);
+    return path_select(p, keep);
+}
+
+void path_resample(Path &path, Path &guide, double chord_tol, double angle_tol) {
+    std::vector<size_t> keep = resample_indices(path, &guide, chord_tol, angle_tol);
+    path = path_select(path, keep);
+    guide = path_select(guide, keep);
+}
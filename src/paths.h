@@ -24,18 +24,53 @@
 #include "geometry.h"
 #include "matrix.h"
 
-Path path_line(Point start, Point end, int npoints);
-Path path_arc(double start_angle, double end_angle, double radius, Point center, int npoints);
-Path path_helix(double start_angle, double end_angle, double radius, double height, Point center, int npoints);
-Path path_ell_arc(double start_angle, double end_angle, double a, double b, Point center, int npoints);
-
-Path path_concat(Path p1, Path p2);
-Path path_translate(Path p, Vector v);
-Path path_transform(Path p, Matrix M);
-Path path_scale(Path p, Vector k);
+Path path_line(const Point &start, const Point &end, int npoints);
+Path path_arc(double start_angle, double end_angle, double radius, const Point &center, int npoints);
+Path path_helix(double start_angle, double end_angle, double radius, double height, const Point &center, int npoints);
+Path path_ell_arc(double start_angle, double end_angle, double a, double b, const Point &center, int npoints);
+
+/*
+ * path_concat reuses the storage of a first path passed as a temporary;
+ * path_append extends a path in place.
+ */
+Path path_concat(const Path &p1, const Path &p2);
+Path path_concat(Path &&p1, const Path &p2);
+void path_append(Path &path, const Path &tail);
+
+/*
+ * The transforms work in place on their argument, so that a temporary
+ * passed in is reused rather than copied. To move a path through several
+ * transforms, compose them into one Affine and call path_transform once,
+ * or keep the path lazy (path_gen.h) so the chain is applied when the
+ * samples are consumed.
+ */
+Path path_translate(Path p, const Vector &v);
+Path path_transform(Path p, const Matrix &M);
+Path path_transform(Path p, const Affine &A);
+Path path_scale(Path p, const Vector &k);
 Path path_scale(Path p, double k);
-Path path_rotate(Path p, Vector angles);
-Path path_rotate(Path p, double angle, Vector n);
+Path path_rotate(Path p, const Vector &angles);
+Path path_rotate(Path p, double angle, const Vector &n);
+
+/*
+ * Adaptive sampling. chord_tol bounds the distance between the curve and
+ * the polyline through the samples, angle_tol bounds the tangent turning
+ * between consecutive samples (in radians).
+ */
+int path_arc_npoints(double angle, double radius, double chord_tol, double angle_tol);
+
+Path path_line_adaptive(const Point &start, const Point &end);
+Path path_arc_adaptive(double start_angle, double end_angle, double radius, const Point &center, double chord_tol, double angle_tol);
+Path path_helix_adaptive(double start_angle, double end_angle, double radius, double height, const Point &center, double chord_tol, double angle_tol);
+Path path_ell_arc_adaptive(double start_angle, double end_angle, double a, double b, const Point &center, double chord_tol, double angle_tol);
+
+/*
+ * Keep the subset of samples needed to meet the tolerances, judging the
+ * curvature from the stored tangents. The two-path version picks the same
+ * samples in both paths, keeping a path and its guide in lockstep.
+ */
+Path path_resample(const Path &p, double chord_tol, double angle_tol);
+void path_resample(Path &path, Path &guide, double chord_tol, double angle_tol);
 
 #endif
 
@@ -0,0 +1,62 @@
+/*
+ * sincos.cxx - Incremental evaluation of sines and cosines
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "sincos.h"
+
+// Interleaved recurrences, advanced together by SINCOS_LANES steps
+#define SINCOS_LANES 4
+
+void sincos_sequence(double a0, double da, size_t begin, size_t end, double *c, double *s) {
+    double cd = std::cos(da), sd = std::sin(da);
+    double cl = std::cos(SINCOS_LANES * da), sl = std::sin(SINCOS_LANES * da);
+
+    for(size_t base = begin - begin % SINCOS_RESEED; base < end; base += SINCOS_RESEED) {
+        size_t block_end = std::min(end, base + SINCOS_RESEED);
+        double lc[SINCOS_LANES], ls[SINCOS_LANES];
+
+        // Lane j starts at angle index base + j
+        lc[0] = std::cos(a0 + base * da);
+        ls[0] = std::sin(a0 + base * da);
+        for(int j = 1; j < SINCOS_LANES; j++) {
+            lc[j] = lc[j-1] * cd - ls[j-1] * sd;
+            ls[j] = ls[j-1] * cd + lc[j-1] * sd;
+        }
+
+        for(size_t i = base; i < block_end; i += SINCOS_LANES) {
+            for(int j = 0; j < SINCOS_LANES; j++) {
+                if(i + j >= begin && i + j < block_end) {
+                    c[i + j - begin] = lc[j];
+                    s[i + j - begin] = ls[j];
+                }
+            }
+
+            // Independent across lanes, so this vectorizes
+            for(int j = 0; j < SINCOS_LANES; j++) {
+                double cj = lc[j] * cl - ls[j] * sl;
+                double sj = ls[j] * cl + lc[j] * sl;
+                lc[j] = cj;
+                ls[j] = sj;
+            }
+        }
+    }
+}
@@ -0,0 +1,37 @@
+/*
+ * sincos.h - Incremental evaluation of sines and cosines
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_SINCOS_H_
+#define _I_SINCOS_H_
+
+#include <cstddef>
+
+/*
+ * c[k] = cos(a0 + i*da) and s[k] = sin(a0 + i*da) for i = begin + k in
+ * [begin, end), using a rotation recurrence instead of the libm functions.
+ * The recurrence restarts from std::cos/std::sin at every multiple of
+ * SINCOS_RESEED, which bounds the accumulated rounding error and makes the
+ * values independent of how [0, n) is split into calls.
+ */
+#define SINCOS_RESEED 64
+
+void sincos_sequence(double a0, double da, size_t begin, size_t end, double *c, double *s);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * task_pool.cxx - Work-stealing thread pool
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "task_pool.h"
+
+#include <thread>
+
+TaskPool::TaskPool(int nthreads): queues(nthreads > 0 ? nthreads : 1), pending(0), spawned(0) {
+}
+
+void TaskPool::spawn(int worker, Task task) {
+    Queue &q = this->queues[worker];
+
+    // Counted before it is visible, so that nobody sees the pool empty
+    this->pending++;
+
+    {
+        std::lock_guard<std::mutex> guard(q.lock);
+        q.tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(this->idle_lock);
+        this->spawned++;
+    }
+    this->idle.notify_one();
+}
+
+bool TaskPool::pop(int worker, Task &task) {
+    Queue &q = this->queues[worker];
+    std::lock_guard<std::mutex> guard(q.lock);
+
+    if(q.tasks.empty())
+        return false;
+
+    task = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+/*
+ * Take the oldest task of another worker, which is usually the largest
+ * piece of work left there
+ */
+bool TaskPool::steal(int worker, Task &task) {
+    int n = this->queues.size();
+
+    for(int k = 1; k < n; k++) {
+        Queue &q = this->queues[(worker + k) % n];
+        std::lock_guard<std::mutex> guard(q.lock);
+
+        if(!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * A worker finding no task sleeps until one is spawned after it looked,
+ * or until the last one is done. The count of spawned tasks only changes
+ * under idle_lock, so that no wakeup is lost between looking and waiting.
+ */
+void TaskPool::work(int worker) {
+    Task task;
+
+    while(this->pending > 0) {
+        size_t seen = this->spawned;
+
+        if(this->pop(worker, task) || this->steal(worker, task)) {
+            task(worker);
+            task = Task();
+            if(--this->pending == 0) {
+                std::lock_guard<std::mutex> guard(this->idle_lock);
+                this->idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(this->idle_lock);
+        this->idle.wait(guard, [&] { return this->spawned != seen || this->pending == 0; });
+    }
+}
+
+void TaskPool::run() {
+    std::vector<std::thread> workers;
+
+    for(int w = 1; w < this->size(); w++)
+        workers.push_back(std::thread(&TaskPool::work, this, w));
+    this->work(0);
+
+    for(size_t w = 0; w < workers.size(); w++)
+        workers[w].join();
+}
@@ -0,0 +1,75 @@
+/*
+ * task_pool.h - Work-stealing thread pool
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_TASK_POOL_H_
+#define _I_TASK_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+ * Work-stealing pool: each worker runs tasks from the back of its own
+ * deque, and steals from the front of the others' when it runs dry, or
+ * sleeps until a task is spawned. Tasks get the index of the worker
+ * running them, so that they can spawn subtasks onto its deque and keep
+ * per-worker state.
+ */
+class TaskPool {
+public:
+    typedef std::function<void(int worker)> Task;
+
+    TaskPool(int nthreads);
+
+    int size() const { return this->queues.size(); }
+
+    // Queue a task on a worker, either before run() or from a running task
+    void spawn(int worker, Task task);
+
+    // Run all the tasks, including those they spawn, and return when done.
+    // The calling thread is worker 0.
+    void run();
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue> queues;
+    std::atomic<size_t> pending;
+
+    // Idle workers wait for spawned to change or pending to reach 0
+    std::mutex idle_lock;
+    std::condition_variable idle;
+    std::atomic<size_t> spawned;
+
+    bool pop(int worker, Task &task);
+    bool steal(int worker, Task &task);
+    void work(int worker);
+
+    TaskPool(const TaskPool &);
+    TaskPool &operator=(const TaskPool &);
+};
+
+#endif
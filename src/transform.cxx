@@ -0,0 +1,242 @@
+/*
+ * transform.cxx - Batched point transforms
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transform.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRANSFORM_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*transform_kernel)(const double *m, const double *t, const double *x, const double *y, const double *z, size_t n, double *out);
+typedef void (*transform_kernel_f)(const float *m, const float *t, const float *x, const float *y, const float *z, size_t n, float *out);
+
+/*
+ * The accumulation order (0 + m0*x) + m1*y + m2*z, then + t, is the one of
+ * Matrix::operator*(Vector), so that every kernel gives the same result.
+ */
+static void transform_scalar(const double *m, const double *t, const double *x, const double *y, const double *z, size_t n, double *out) {
+    for(size_t i = 0; i < n; i++) {
+        for(int r = 0; r < 3; r++) {
+            double v = 0.;
+            v += m[3*r] * x[i];
+            v += m[3*r+1] * y[i];
+            v += m[3*r+2] * z[i];
+            out[3*i+r] = t[r] + v;
+        }
+    }
+}
+
+static void transform_scalar_f(const float *m, const float *t, const float *x, const float *y, const float *z, size_t n, float *out) {
+    for(size_t i = 0; i < n; i++) {
+        for(int r = 0; r < 3; r++) {
+            float v = 0.f;
+            v += m[3*r] * x[i];
+            v += m[3*r+1] * y[i];
+            v += m[3*r+2] * z[i];
+            out[3*i+r] = t[r] + v;
+        }
+    }
+}
+
+#ifdef TRANSFORM_X86
+
+__attribute__((target("sse2")))
+static void transform_sse2(const double *m, const double *t, const double *x, const double *y, const double *z, size_t n, double *out) {
+    __m128d zero = _mm_setzero_pd();
+    __m128d M[9], T[3];
+    size_t i = 0;
+
+    for(int k = 0; k < 9; k++)
+        M[k] = _mm_set1_pd(m[k]);
+    for(int k = 0; k < 3; k++)
+        T[k] = _mm_set1_pd(t[k]);
+
+    for(; i + 2 <= n; i += 2) {
+        __m128d X = _mm_loadu_pd(x + i), Y = _mm_loadu_pd(y + i), Z = _mm_loadu_pd(z + i);
+        __m128d R[3];
+
+        for(int r = 0; r < 3; r++) {
+            __m128d v = _mm_add_pd(zero, _mm_mul_pd(M[3*r], X));
+            v = _mm_add_pd(v, _mm_mul_pd(M[3*r+1], Y));
+            v = _mm_add_pd(v, _mm_mul_pd(M[3*r+2], Z));
+            R[r] = _mm_add_pd(T[r], v);
+        }
+
+        // (x0 x1) (y0 y1) (z0 z1) -> x0 y0 | z0 x1 | y1 z1
+        _mm_storeu_pd(out + 3*i, _mm_unpacklo_pd(R[0], R[1]));
+        _mm_storeu_pd(out + 3*i + 2, _mm_shuffle_pd(R[2], R[0], 2));
+        _mm_storeu_pd(out + 3*i + 4, _mm_unpackhi_pd(R[1], R[2]));
+    }
+
+    transform_scalar(m, t, x + i, y + i, z + i, n - i, out + 3*i);
+}
+
+__attribute__((target("avx2")))
+static void transform_avx2(const double *m, const double *t, const double *x, const double *y, const double *z, size_t n, double *out) {
+    __m256d zero = _mm256_setzero_pd();
+    __m256d M[9], T[3];
+    size_t i = 0;
+
+    for(int k = 0; k < 9; k++)
+        M[k] = _mm256_set1_pd(m[k]);
+    for(int k = 0; k < 3; k++)
+        T[k] = _mm256_set1_pd(t[k]);
+
+    for(; i + 4 <= n; i += 4) {
+        __m256d X = _mm256_loadu_pd(x + i), Y = _mm256_loadu_pd(y + i), Z = _mm256_loadu_pd(z + i);
+        __m256d R[3];
+
+        for(int r = 0; r < 3; r++) {
+            __m256d v = _mm256_add_pd(zero, _mm256_mul_pd(M[3*r], X));
+            v = _mm256_add_pd(v, _mm256_mul_pd(M[3*r+1], Y));
+            v = _mm256_add_pd(v, _mm256_mul_pd(M[3*r+2], Z));
+            R[r] = _mm256_add_pd(T[r], v);
+        }
+
+        // Interleave into x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+        __m256d xy = _mm256_unpacklo_pd(R[0], R[1]);     // x0 y0 x2 y2
+        __m256d zx = _mm256_shuffle_pd(R[2], R[0], 0xA); // z0 x1 z2 x3
+        __m256d yz = _mm256_shuffle_pd(R[1], R[2], 0xF); // y1 z1 y3 z3
+        _mm256_storeu_pd(out + 3*i, _mm256_permute2f128_pd(xy, zx, 0x20));
+        _mm256_storeu_pd(out + 3*i + 4, _mm256_permute2f128_pd(yz, xy, 0x30));
+        _mm256_storeu_pd(out + 3*i + 8, _mm256_permute2f128_pd(zx, yz, 0x31));
+    }
+
+    transform_sse2(m, t, x + i, y + i, z + i, n - i, out + 3*i);
+}
+
+/*
+ * Single precision: four points per SSE register, eight per AVX register
+ */
+__attribute__((target("sse2")))
+static inline void store_points_sse2(__m128 X, __m128 Y, __m128 Z, float *out) {
+    // (x0 x1 x2 x3) (y...) (z...) -> x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    __m128 lo = _mm_unpacklo_ps(X, Y);                           // x0 y0 x1 y1
+    __m128 hi = _mm_unpackhi_ps(X, Y);                           // x2 y2 x3 y3
+    __m128 zx = _mm_shuffle_ps(Z, lo, _MM_SHUFFLE(2, 2, 0, 0));  // z0 z0 x1 x1
+    __m128 yz = _mm_shuffle_ps(lo, Z, _MM_SHUFFLE(1, 1, 3, 3));  // y1 y1 z1 z1
+    __m128 zx2 = _mm_shuffle_ps(Z, hi, _MM_SHUFFLE(2, 2, 2, 2)); // z2 z2 x3 x3
+    __m128 yz2 = _mm_shuffle_ps(hi, Z, _MM_SHUFFLE(3, 3, 3, 3)); // y3 y3 z3 z3
+    _mm_storeu_ps(out, _mm_shuffle_ps(lo, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(yz, hi, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(zx2, yz2, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+__attribute__((target("sse2")))
+static void transform_sse2_f(const float *m, const float *t, const float *x, const float *y, const float *z, size_t n, float *out) {
+    __m128 zero = _mm_setzero_ps();
+    __m128 M[9], T[3];
+    size_t i = 0;
+
+    for(int k = 0; k < 9; k++)
+        M[k] = _mm_set1_ps(m[k]);
+    for(int k = 0; k < 3; k++)
+        T[k] = _mm_set1_ps(t[k]);
+
+    for(; i + 4 <= n; i += 4) {
+        __m128 X = _mm_loadu_ps(x + i), Y = _mm_loadu_ps(y + i), Z = _mm_loadu_ps(z + i);
+        __m128 R[3];
+
+        for(int r = 0; r < 3; r++) {
+            __m128 v = _mm_add_ps(zero, _mm_mul_ps(M[3*r], X));
+            v = _mm_add_ps(v, _mm_mul_ps(M[3*r+1], Y));
+            v = _mm_add_ps(v, _mm_mul_ps(M[3*r+2], Z));
+            R[r] = _mm_add_ps(T[r], v);
+        }
+
+        store_points_sse2(R[0], R[1], R[2], out + 3*i);
+    }
+
+    transform_scalar_f(m, t, x + i, y + i, z + i, n - i, out + 3*i);
+}
+
+__attribute__((target("avx2")))
+static void transform_avx2_f(const float *m, const float *t, const float *x, const float *y, const float *z, size_t n, float *out) {
+    __m256 zero = _mm256_setzero_ps();
+    __m256 M[9], T[3];
+    size_t i = 0;
+
+    for(int k = 0; k < 9; k++)
+        M[k] = _mm256_set1_ps(m[k]);
+    for(int k = 0; k < 3; k++)
+        T[k] = _mm256_set1_ps(t[k]);
+
+    for(; i + 8 <= n; i += 8) {
+        __m256 X = _mm256_loadu_ps(x + i), Y = _mm256_loadu_ps(y + i), Z = _mm256_loadu_ps(z + i);
+        __m256 R[3];
+
+        for(int r = 0; r < 3; r++) {
+            __m256 v = _mm256_add_ps(zero, _mm256_mul_ps(M[3*r], X));
+            v = _mm256_add_ps(v, _mm256_mul_ps(M[3*r+1], Y));
+            v = _mm256_add_ps(v, _mm256_mul_ps(M[3*r+2], Z));
+            R[r] = _mm256_add_ps(T[r], v);
+        }
+
+        // Interleave each half as four points
+        store_points_sse2(_mm256_castps256_ps128(R[0]), _mm256_castps256_ps128(R[1]), _mm256_castps256_ps128(R[2]), out + 3*i);
+        store_points_sse2(_mm256_extractf128_ps(R[0], 1), _mm256_extractf128_ps(R[1], 1), _mm256_extractf128_ps(R[2], 1), out + 3*i + 12);
+    }
+
+    transform_sse2_f(m, t, x + i, y + i, z + i, n - i, out + 3*i);
+}
+
+#endif
+
+static transform_kernel_f select_kernel_f() {
+#ifdef TRANSFORM_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return transform_avx2_f;
+    if(__builtin_cpu_supports("sse2"))
+        return transform_sse2_f;
+#endif
+    return transform_scalar_f;
+}
+
+static transform_kernel select_kernel() {
+#ifdef TRANSFORM_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return transform_avx2;
+    if(__builtin_cpu_supports("sse2"))
+        return transform_sse2;
+#endif
+    return transform_scalar;
+}
+
+void transform_points(const Matrix &M, const Point &t, const double *x, const double *y, const double *z, size_t n, Point *out) {
+    static const transform_kernel kernel = select_kernel();
+    double tc[3] = {t.x, t.y, t.z};
+
+    static_assert(sizeof(Point) == 3 * sizeof(double), "Point must be three packed doubles");
+    kernel(&M.coeffs[0][0], tc, x, y, z, n, &out->x);
+}
+
+void transform_points(const Matrix &M, const Point &t, const float *x, const float *y, const float *z, size_t n, Pointf *out) {
+    static const transform_kernel_f kernel = select_kernel_f();
+    float mc[9], tc[3] = {(float)t.x, (float)t.y, (float)t.z};
+
+    for(int k = 0; k < 9; k++)
+        mc[k] = M.coeffs[k / 3][k % 3];
+
+    static_assert(sizeof(Pointf) == 3 * sizeof(float), "Pointf must be three packed floats");
+    kernel(mc, tc, x, y, z, n, &out->x);
+}
@@ -0,0 +1,45 @@
+/*
+ * transform.h - Batched point transforms
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_TRANSFORM_H_
+#define _I_TRANSFORM_H_
+
+#include <cstddef>
+
+#include "geometry.h"
+#include "matrix.h"
+
+/*
+ * out[i] = t + M * (x[i], y[i], z[i]) for i in [0, n)
+ *
+ * The input coordinates are given as separate arrays. The widest kernel
+ * supported by the CPU (AVX2, SSE2 or scalar) is picked on first use.
+ * Results are bit-identical to Matrix::operator*(Vector) followed by the
+ * addition of t.
+ */
+void transform_points(const Matrix &M, const Point &t, const double *x, const double *y, const double *z, size_t n, Point *out);
+
+/*
+ * Single precision variant, twice as many points per instruction. M and t
+ * are rounded to float, and the kernels agree with each other bit for bit.
+ */
+void transform_points(const Matrix &M, const Point &t, const float *x, const float *y, const float *z, size_t n, Pointf *out);
+
+#endif
@@ -0,0 +1,341 @@
+/*
+ * triangulate.cxx - Polygon triangulation
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include "triangulate.h"
+
+/*
+ * Polygon in counter-clockwise order: pt[i] are the coordinates of the
+ * i-th vertex, idx[i] its index in the caller's polygon
+ */
+class CCWPolygon {
+public:
+    std::vector<double> px, py;
+    std::vector<unsigned int> idx;
+
+    size_t size() const { return this->idx.size(); }
+
+    // Sweep order: higher y first, then lower x
+    bool above(int a, int b) const {
+        return this->py[a] > this->py[b] || (this->py[a] == this->py[b] && this->px[a] < this->px[b]);
+    }
+
+    double cross(int o, int a, int b) const {
+        return (this->px[a] - this->px[o]) * (this->py[b] - this->py[o])
+             - (this->py[a] - this->py[o]) * (this->px[b] - this->px[o]);
+    }
+};
+
+static double signed_area(const std::vector<double> &x, const std::vector<double> &y) {
+    size_t n = x.size();
+    double a = 0.;
+
+    for(size_t i = 0, j = n - 1; i < n; j = i++)
+        a += x[j] * y[i] - x[i] * y[j];
+
+    return 0.5 * a;
+}
+
+bool polygon_is_convex(const std::vector<double> &x, const std::vector<double> &y) {
+    size_t n = x.size();
+    int sign = 0;
+    double turn = 0.;
+
+    if(n < 3)
+        return false;
+
+    for(size_t i = 0; i < n; i++) {
+        size_t a = (i + n - 1) % n, b = (i + 1) % n;
+        double ux = x[i] - x[a], uy = y[i] - y[a];
+        double vx = x[b] - x[i], vy = y[b] - y[i];
+        double c = ux * vy - uy * vx;
+
+        if(c > 0.) {
+            if(sign < 0)
+                return false;
+            sign = 1;
+        } else if(c < 0.) {
+            if(sign > 0)
+                return false;
+            sign = -1;
+        }
+        turn += std::atan2(c, ux * vx + uy * vy);
+    }
+
+    // Turning once around rules out self-intersecting stars
+    return sign != 0 && std::fabs(std::fabs(turn) - 2. * M_PI) < 1e-6;
+}
+
+/*
+ * Status of the sweep line: the edges having the polygon interior on their
+ * right, ordered by their abscissa at the current sweep position.
+ */
+class EdgeOrder {
+public:
+    const CCWPolygon *poly;
+    const double *sx, *sy;
+
+    EdgeOrder(const CCWPolygon *poly, const double *sx, const double *sy): poly(poly), sx(sx), sy(sy) {}
+
+    // Abscissa of edge e (from vertex e to e+1) on the sweep line, -1 being the sweep point
+    double xat(int e) const {
+        if(e < 0)
+            return *this->sx;
+
+        const CCWPolygon &P = *this->poly;
+        int a = e, b = (e + 1) % P.size();
+        double ya = P.py[a], yb = P.py[b];
+
+        if(ya == yb)
+            return std::max(std::min(*this->sx, std::max(P.px[a], P.px[b])), std::min(P.px[a], P.px[b]));
+        return P.px[a] + (*this->sy - ya) / (yb - ya) * (P.px[b] - P.px[a]);
+    }
+
+    bool operator ()(int a, int b) const {
+        double xa = this->xat(a), xb = this->xat(b);
+        if(xa != xb)
+            return xa < xb;
+        return a < b;
+    }
+};
+
+enum VertexType { START, END, SPLIT, MERGE, REGULAR };
+
+/*
+ * Plane sweep adding the diagonals that split the polygon into y-monotone
+ * pieces (de Berg et al., Computational Geometry, ch. 3)
+ */
+static void monotone_diagonals(const CCWPolygon &P, std::vector<std::pair<int, int> > &diagonals) {
+    int n = P.size();
+    std::vector<int> order(n), helper(n);
+    std::vector<VertexType> type(n);
+    double sx = 0., sy = 0.;
+
+    typedef std::set<int, EdgeOrder> Status;
+    Status status(EdgeOrder(&P, &sx, &sy));
+    std::vector<Status::iterator> where(n, status.end());
+
+    for(int i = 0; i < n; i++) {
+        int a = (i + n - 1) % n, b = (i + 1) % n;
+        bool reflex = P.cross(a, i, b) < 0.;
+
+        order[i] = i;
+        if(P.above(i, a) && P.above(i, b))
+            type[i] = reflex ? SPLIT : START;
+        else if(P.above(a, i) && P.above(b, i))
+            type[i] = reflex ? MERGE : END;
+        else
+            type[i] = REGULAR;
+    }
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return P.above(a, b); });
+
+    for(int k = 0; k < n; k++) {
+        int i = order[k], prev = (i + n - 1) % n;
+
+        sx = P.px[i];
+        sy = P.py[i];
+
+        // Fix the helper of an edge ending here, then remove the edge
+        if(type[i] == END || type[i] == MERGE || (type[i] == REGULAR && P.above(prev, i))) {
+            if(type[helper[prev]] == MERGE)
+                diagonals.push_back(std::make_pair(i, helper[prev]));
+            status.erase(where[prev]);
+            where[prev] = status.end();
+        }
+
+        // Update the edge directly left of the vertex
+        if(type[i] == SPLIT || type[i] == MERGE || (type[i] == REGULAR && !P.above(prev, i))) {
+            Status::iterator it = status.lower_bound(-1);
+            if(it != status.begin()) {
+                --it;
+                int e = *it;
+                if(type[i] == SPLIT || type[helper[e]] == MERGE)
+                    diagonals.push_back(std::make_pair(i, helper[e]));
+                helper[e] = i;
+            }
+        }
+
+        // Insert the edge starting here
+        if(type[i] == START || type[i] == SPLIT || (type[i] == REGULAR && P.above(prev, i))) {
+            helper[i] = i;
+            where[i] = status.insert(i).first;
+        }
+    }
+}
+
+/*
+ * Walk the faces of the polygon cut along the diagonals, each one in
+ * counter-clockwise order
+ */
+static void monotone_pieces(const CCWPolygon &P, const std::vector<std::pair<int, int> > &diagonals, std::vector<std::vector<int> > &pieces) {
+    int n = P.size();
+    std::vector<std::vector<int> > adj(n);
+
+    for(int i = 0; i < n; i++)
+        adj[i].push_back((i + 1) % n);
+    for(size_t d = 0; d < diagonals.size(); d++) {
+        adj[diagonals[d].first].push_back(diagonals[d].second);
+        adj[diagonals[d].second].push_back(diagonals[d].first);
+    }
+
+    // Half-edges out of v, sorted counter-clockwise; (v -> prev) closes the list
+    std::vector<std::vector<int> > fan(n);
+    for(int v = 0; v < n; v++) {
+        fan[v] = adj[v];
+        fan[v].push_back((v + n - 1) % n);
+        std::sort(fan[v].begin(), fan[v].end(), [&](int a, int b) {
+            return std::atan2(P.py[a] - P.py[v], P.px[a] - P.px[v]) < std::atan2(P.py[b] - P.py[v], P.px[b] - P.px[v]);
+        });
+    }
+
+    std::vector<std::set<int> > used(n);
+    for(int u = 0; u < n; u++) {
+        for(size_t k = 0; k < adj[u].size(); k++) {
+            int v = adj[u][k];
+            if(used[u].count(v))
+                continue;
+
+            std::vector<int> piece;
+            int a = u, b = v;
+            while(!used[a].count(b) && piece.size() <= (size_t)n) {
+                used[a].insert(b);
+                piece.push_back(a);
+
+                // Next half-edge: first one clockwise from (b -> a)
+                std::vector<int> &f = fan[b];
+                size_t pos = std::find(f.begin(), f.end(), a) - f.begin();
+                int c = f[(pos + f.size() - 1) % f.size()];
+                a = b;
+                b = c;
+            }
+            pieces.push_back(piece);
+        }
+    }
+}
+
+/*
+ * Stack-based triangulation of a y-monotone counter-clockwise polygon
+ */
+static void triangulate_monotone(const CCWPolygon &P, const std::vector<int> &piece, std::vector<Face> &out) {
+    int k = piece.size();
+
+    if(k < 3)
+        return;
+
+    int top = 0, bottom = 0;
+    for(int i = 1; i < k; i++) {
+        if(P.above(piece[i], piece[top]))
+            top = i;
+        if(P.above(piece[bottom], piece[i]))
+            bottom = i;
+    }
+
+    // Going counter-clockwise from the top, the left chain comes first
+    std::vector<int> u;
+    std::vector<bool> left(P.size(), false);
+    for(int i = top; i != bottom; i = (i + 1) % k)
+        left[piece[i]] = true;
+    u = piece;
+    std::sort(u.begin(), u.end(), [&](int a, int b) { return P.above(a, b); });
+
+    std::vector<int> stack;
+    stack.push_back(u[0]);
+    stack.push_back(u[1]);
+
+    for(int j = 2; j < k - 1; j++) {
+        if(left[u[j]] != left[stack.back()]) {
+            // Opposite chain: connect to every stacked vertex
+            for(size_t s = 1; s < stack.size(); s++)
+                out.push_back(Face(u[j], stack[s - 1], stack[s]));
+            stack.clear();
+            stack.push_back(u[j - 1]);
+            stack.push_back(u[j]);
+        } else {
+            // Same chain: cut off triangles as long as the diagonal is inside
+            int last = stack.back();
+            stack.pop_back();
+            while(!stack.empty()) {
+                double c = P.cross(stack.back(), last, u[j]);
+                if(left[u[j]] ? c <= 0. : c >= 0.)
+                    break;
+                out.push_back(Face(stack.back(), last, u[j]));
+                last = stack.back();
+                stack.pop_back();
+            }
+            stack.push_back(last);
+            stack.push_back(u[j]);
+        }
+    }
+
+    for(size_t s = 1; s < stack.size(); s++)
+        out.push_back(Face(u[k - 1], stack[s - 1], stack[s]));
+}
+
+std::vector<Face> triangulate_polygon(const std::vector<double> &x, const std::vector<double> &y) {
+    std::vector<Face> tris;
+    size_t n = x.size();
+
+    if(n < 3)
+        return tris;
+
+    double area = signed_area(x, y);
+    bool ccw = area >= 0.;
+
+    // Flat polygons have no interior to sweep
+    if(area == 0. || polygon_is_convex(x, y)) {
+        for(unsigned int i = 1; i + 1 < n; i++)
+            tris.push_back(Face(0, i, i + 1));
+        return tris;
+    }
+
+    CCWPolygon P;
+    for(size_t k = 0; k < n; k++) {
+        size_t i = ccw ? k : n - 1 - k;
+        P.px.push_back(x[i]);
+        P.py.push_back(y[i]);
+        P.idx.push_back(i);
+    }
+
+    std::vector<std::pair<int, int> > diagonals;
+    std::vector<std::vector<int> > pieces;
+    std::vector<Face> local;
+
+    monotone_diagonals(P, diagonals);
+    monotone_pieces(P, diagonals, pieces);
+    for(size_t p = 0; p < pieces.size(); p++)
+        triangulate_monotone(P, pieces[p], local);
+
+    // Back to the caller's indices and winding
+    for(size_t t = 0; t < local.size(); t++) {
+        unsigned int *v = local[t].indices;
+        if(P.cross(v[0], v[1], v[2]) < 0.)
+            std::swap(v[1], v[2]);
+        if(ccw)
+            tris.push_back(Face(P.idx[v[0]], P.idx[v[1]], P.idx[v[2]]));
+        else
+            tris.push_back(Face(P.idx[v[0]], P.idx[v[2]], P.idx[v[1]]));
+    }
+
+    return tris;
+}
@@ -0,0 +1,39 @@
+/*
+ * triangulate.h - Polygon triangulation
+ *
+ * Copyright (C) 2011 Olivier Iffrig
+ * Authors: Olivier Iffrig <olivier@iffrig.eu>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _I_TRIANGULATE_H_
+#define _I_TRIANGULATE_H_
+
+#include <vector>
+
+#include "geometry.h"
+
+bool polygon_is_convex(const std::vector<double> &x, const std::vector<double> &y);
+
+/*
+ * Triangulate the simple polygon with vertices (x[i], y[i]), which must not
+ * repeat consecutively. The n-2 triangles index the input vertices and have
+ * the same winding as the polygon. Convex polygons are fanned in O(n),
+ * other ones are split into monotone pieces by a plane sweep and
+ * triangulated in O(n log n).
+ */
+std::vector<Face> triangulate_polygon(const std::vector<double> &x, const std::vector<double> &y);
+
+#endif